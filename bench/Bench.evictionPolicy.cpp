@@ -0,0 +1,150 @@
+// Replays an access trace against the eviction policies with the same resident
+// set bookkeeping Storage::fitSize uses and reports hit ratios.
+//
+// Usage: binary_storage_bench_eviction [trace|-] [cashSize] [cashBytes]
+// The trace holds one "key size" pair per line. Without a trace or with "-" a synthetic one
+// is generated: a Zipf distributed hot set interleaved with one-off scans of
+// larger values.
+
+#include <storage/EvictionPolicy.hpp>
+
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <unordered_map>
+
+using namespace binary_storage::storage;
+
+struct Access {
+    std::string key;
+    size_t size;
+};
+
+static std::vector<Access> syntheticTrace() {
+    constexpr size_t hotKeys = 2000;
+    constexpr size_t accesses = 400000;
+
+    std::vector<double> weights(hotKeys);
+    for (size_t i = 0; i < hotKeys; ++i) {
+        weights[i] = 1.0 / std::pow(static_cast<double>(i + 1), 0.9);
+    }
+
+    std::mt19937_64 random {42};
+    std::discrete_distribution<size_t> zipf(weights.begin(), weights.end());
+    std::uniform_int_distribution<size_t> hotSize(64, 4096);
+    std::vector<size_t> sizes(hotKeys);
+    for (auto& size: sizes) {
+        size = hotSize(random);
+    }
+
+    std::vector<Access> trace;
+    trace.reserve(accesses);
+    size_t scanKey = 0;
+    while (trace.size() < accesses) {
+        for (size_t i = 0; i < 5000; ++i) {
+            auto const key = zipf(random);
+            trace.push_back({"hot" + std::to_string(key), sizes[key]});
+        }
+        for (size_t i = 0; i < 1000; ++i) {
+            trace.push_back({"scan" + std::to_string(scanKey++), 16384});
+        }
+    }
+    return trace;
+}
+
+static std::vector<Access> loadTrace(std::string const& path) {
+    std::vector<Access> trace;
+    std::ifstream stream(path);
+    Access access;
+    while (stream >> access.key >> access.size) {
+        trace.push_back(access);
+    }
+    return trace;
+}
+
+struct Result {
+    double hitRatio;
+    double byteHitRatio;
+    double nanosecondsPerAccess;
+};
+
+static Result replay(std::vector<Access> const& trace, 
+                     EvictionPolicy& policy, 
+                     size_t cashSize, 
+                     size_t cashBytes, 
+                     double resizeCoeff) {
+    struct Entry {
+        size_t size;
+        std::chrono::system_clock::time_point lastAccess;
+    };
+
+    std::unordered_map<std::string, Entry> resident;
+    size_t residentBytes = 0;
+    size_t hits = 0;
+    size_t bytes = 0;
+    size_t bytesHit = 0;
+    auto const begin = std::chrono::steady_clock::now();
+
+    for (size_t tick = 0; tick < trace.size(); ++tick) {
+        auto const& access = trace[tick];
+        policy.recordAccess(access.key);
+        bytes += access.size;
+
+        auto const iter = resident.find(access.key);
+        if (iter != resident.end()) {
+            ++hits;
+            bytesHit += access.size;
+            continue;
+        }
+
+        auto const now = std::chrono::system_clock::time_point(std::chrono::microseconds(tick));
+        resident.emplace(access.key, Entry {access.size, now});
+        residentBytes += access.size;
+        if (resident.size() <= cashSize and (cashBytes == 0 or residentBytes <= cashBytes)) {
+            continue;
+        }
+
+        std::vector<std::unordered_map<std::string, Entry>::iterator> nodes;
+        std::vector<EvictionPolicy::Candidate> candidates;
+        for (auto it = resident.begin(); it != resident.end(); ++it) {
+            nodes.push_back(it);
+            candidates.push_back({&it->first, it->second.lastAccess, cashBytes == 0 ? 0 : it->second.size});
+        }
+
+        EvictionPolicy::Budget const budget {static_cast<size_t>(cashSize / resizeCoeff),
+                                             static_cast<size_t>(cashBytes / resizeCoeff)};
+        for (auto const index: policy.selectVictims(candidates, budget)) {
+            residentBytes -= nodes[index]->second.size;
+            resident.erase(nodes[index]);
+        }
+    }
+
+    auto const elapsed = std::chrono::steady_clock::now() - begin;
+    return {static_cast<double>(hits) / static_cast<double>(trace.size()),
+            static_cast<double>(bytesHit) / static_cast<double>(bytes),
+            std::chrono::duration<double, std::nano>(elapsed).count() / static_cast<double>(trace.size())};
+}
+
+int main(int argc, char** argv) {
+    auto const trace = argc > 1 and std::string(argv[1]) != "-" ? loadTrace(argv[1]) : syntheticTrace();
+    size_t const cashSize = argc > 2 ? std::stoul(argv[2]) : 500;
+    size_t const cashBytes = argc > 3 ? std::stoul(argv[3]) : 0;
+    if (trace.empty()) {
+        std::cerr << "Empty trace" << std::endl;
+        return 1;
+    }
+
+    RecencyPolicy recency;
+    TinyLfuPolicy tinyLfu(cashSize * 8);
+
+    std::cout << "accesses: " << trace.size() << ", cashSize: " << cashSize << ", cashBytes: " << cashBytes << std::endl;
+    for (auto const& [name, policy]: {std::pair<char const*, EvictionPolicy*> {"recency", &recency},
+                                      std::pair<char const*, EvictionPolicy*> {"tinylfu", &tinyLfu}}) {
+        auto const result = replay(trace, *policy, cashSize, cashBytes, 1.25);
+        std::cout << name << "\thit ratio: " << result.hitRatio << "\tbyte hit ratio: " << result.byteHitRatio
+                  << "\tns/access: " << result.nanosecondsPerAccess << std::endl;
+    }
+    return 0;
+}
@@ -0,0 +1,93 @@
+// Throughput of the parallel chunked encoding: a large vector of numbers and
+// one of strings are encoded into chunk buffers and decoded back with the
+// chunks spread over a ThreadPool, from one thread up to all cores.
+//
+// Usage: binary_storage_bench_serde [elements] [chunkElements] [rounds]
+
+#include <serde/parallel.hpp>
+#include <storage/ThreadPool.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <thread>
+
+using namespace binary_storage;
+
+struct Throughput {
+    double encode;
+    double decode;
+};
+
+template<class T>
+static Throughput run(T const& value, size_t threads, size_t chunkElements, size_t rounds) {
+    std::unique_ptr<storage::ThreadPool> pool;
+    if (threads > 1) {
+        pool = std::make_unique<storage::ThreadPool>(threads - 1);
+    }
+    serde::ParallelFor const parallelFor = [&pool] (size_t count, std::function<void(size_t)> const& task) {
+        if (pool == nullptr) {
+            for (size_t i = 0; i < count; ++i) {
+                task(i);
+            }
+        } else {
+            pool->parallelFor(count, task);
+        }
+    };
+
+    size_t bytes = 0;
+    auto begin = std::chrono::steady_clock::now();
+    for (size_t round = 0; round < rounds; ++round) {
+        bytes += serde::encodeChunkedParallel(value, chunkElements, parallelFor).size();
+    }
+    auto const encode = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+
+    std::ostringstream stream;
+    serde::serializeChunkedParallel(stream, value, chunkElements, parallelFor);
+    auto const encoded = stream.str();
+    size_t elements = 0;
+    begin = std::chrono::steady_clock::now();
+    for (size_t round = 0; round < rounds; ++round) {
+        elements += serde::deserializeChunkedParallel<T>(encoded, parallelFor)->size();
+    }
+    auto const decode = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+
+    if (elements != value.size() * rounds) {
+        std::cerr << "decode mismatch" << std::endl;
+    }
+    return {static_cast<double>(bytes) / encode / 1e6, static_cast<double>(encoded.size() * rounds) / decode / 1e6};
+}
+
+int main(int argc, char** argv) {
+    size_t const elements = argc > 1 ? std::stoul(argv[1]) : 4000000;
+    size_t const chunkElements = argc > 2 ? std::stoul(argv[2]) : 65536;
+    size_t const rounds = argc > 3 ? std::stoul(argv[3]) : 5;
+    size_t const cores = std::max<size_t>(std::thread::hardware_concurrency(), 1);
+
+    std::vector<size_t> threads;
+    for (size_t count = 1; count < cores; count *= 2) {
+        threads.push_back(count);
+    }
+    threads.push_back(cores);
+
+    std::vector<double> numbers(elements);
+    std::vector<std::string> words(elements / 4);
+    for (size_t i = 0; i < elements; ++i) {
+        numbers[i] = static_cast<double>(i) * 0.5;
+    }
+    for (size_t i = 0; i < words.size(); ++i) {
+        words[i] = std::string(8 + i % 24, static_cast<char>('a' + i % 26));
+    }
+
+    std::cout << "elements: " << elements << ", chunk elements: " << chunkElements << ", rounds: " << rounds << std::endl;
+    std::cout << "threads\tdouble encode MB/s\tdouble decode MB/s\tstring encode MB/s\tstring decode MB/s" << std::endl;
+    for (auto const count: threads) {
+        auto const bulk = run(numbers, count, chunkElements, rounds);
+        auto const strings = run(words, count, chunkElements, rounds);
+        std::cout << count << '\t' << bulk.encode << "\t\t\t" << bulk.decode << "\t\t\t"
+                  << strings.encode << "\t\t\t" << strings.decode << std::endl;
+    }
+    return 0;
+}
@@ -0,0 +1,90 @@
+// Read-heavy scaling of resident hits: every thread reads random resident
+// keys through Storage::read, with lockFreeReads off (the shared_mutex path)
+// and on (the epoch protected index), from one thread up to all cores.
+//
+// Usage: binary_storage_bench_reads [keys] [readsPerThread] [writeEvery]
+// With writeEvery above zero the first thread stores a key after every
+// writeEvery reads.
+
+#include <storage/Storage.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <thread>
+
+using namespace binary_storage::storage;
+
+static double run(bool lockFree, size_t threads, size_t keys, size_t reads, size_t writeEvery) {
+    BaseParameters params;
+    params.path = "/tmp/binary_storage_bench_reads/";
+    params.cashSize = keys * 2;
+    params.lockFreeReads = lockFree;
+    std::filesystem::remove_all(params.path);
+
+    Storage<std::vector<uint64_t>> storage(params);
+    std::vector<std::string> names;
+    for (size_t i = 0; i < keys; ++i) {
+        names.push_back("key" + std::to_string(i));
+        storage.store(names.back(), std::vector<uint64_t>(16, i));
+    }
+
+    std::atomic<size_t> ready {0};
+    std::atomic<bool> start {false};
+    std::atomic<uint64_t> checksum {0};
+    std::vector<std::thread> workers;
+    for (size_t t = 0; t < threads; ++t) {
+        workers.emplace_back([&, t] {
+            std::mt19937_64 random {t};
+            std::uniform_int_distribution<size_t> key(0, keys - 1);
+            uint64_t sum = 0;
+            ++ready;
+            while (not start) {
+            }
+
+            for (size_t i = 0; i < reads; ++i) {
+                storage.read(names[key(random)], [&sum] (std::vector<uint64_t> const& value) { sum += value[0]; });
+                if (t == 0 and writeEvery != 0 and i % writeEvery == 0) {
+                    auto const index = key(random);
+                    storage.store(names[index], std::vector<uint64_t>(16, index));
+                }
+            }
+            checksum += sum;
+        });
+    }
+
+    while (ready != threads) {
+    }
+    auto const begin = std::chrono::steady_clock::now();
+    start = true;
+    for (auto& worker: workers) {
+        worker.join();
+    }
+
+    auto const elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+    return static_cast<double>(threads * reads) / elapsed / 1e6;
+}
+
+int main(int argc, char** argv) {
+    size_t const keys = argc > 1 ? std::stoul(argv[1]) : 1024;
+    size_t const reads = argc > 2 ? std::stoul(argv[2]) : 1000000;
+    size_t const writeEvery = argc > 3 ? std::stoul(argv[3]) : 0;
+    size_t const cores = std::max<size_t>(std::thread::hardware_concurrency(), 1);
+
+    std::vector<size_t> threads;
+    for (size_t count = 1; count < cores; count *= 2) {
+        threads.push_back(count);
+    }
+    threads.push_back(cores);
+
+    std::cout << "keys: " << keys << ", reads per thread: " << reads << ", write every: " << writeEvery << std::endl;
+    std::cout << "threads\tshared_mutex Mreads/s\tlock-free Mreads/s" << std::endl;
+    for (auto const count: threads) {
+        auto const locked = run(false, count, keys, reads, writeEvery);
+        auto const lockFree = run(true, count, keys, reads, writeEvery);
+        std::cout << count << '\t' << locked << "\t\t\t" << lockFree << std::endl;
+    }
+    return 0;
+}
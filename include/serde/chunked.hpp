@@ -0,0 +1,162 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+#include "serde.hpp"
+
+namespace binary_storage::serde {
+
+// Chunked vector encoding: the element count, the number of elements per
+// chunk and a table with the byte offset of every chunk, relative to the
+// first one, followed by the elements encoded as usual. A range of elements
+// is read by seeking to its chunk, without decoding what comes before it.
+
+// Elements that can be copied to and from the stream as one block of memory.
+template<class T>
+static bool constexpr isBulkElement = isNumeric<typename T::value_type> and not std::is_same_v<typename T::value_type, bool>;
+
+inline size_t chunksCount(size_t size, size_t chunkElements) noexcept {
+    return chunkElements == 0 ? 0 : (size + chunkElements - 1) / chunkElements;
+}
+
+template<class T>
+std::enable_if_t<isContiguous<T>, size_t> serializedChunkedSize(T const& value, size_t chunkElements) noexcept {
+    auto const header = sizeof(typename T::size_type) + sizeof(uint64_t)
+                        + chunksCount(value.size(), chunkElements) * sizeof(uint64_t);
+    return header + serializedSize(value) - sizeof(typename T::size_type);
+}
+
+template<class S, class T>
+std::enable_if_t<isContiguous<T>, void> serializeChunked(S& stream, T const& value, size_t chunkElements) noexcept {
+    assertTypes<S, T>();
+    chunkElements = std::max<size_t>(chunkElements, 1);
+    serialize(stream, value.size());
+    serialize(stream, static_cast<uint64_t>(chunkElements));
+
+    uint64_t offset = 0;
+    for (size_t i = 0; i < value.size(); ++i) {
+        if (i % chunkElements == 0) {
+            serialize(stream, offset);
+        }
+        offset += serializedSize(value[i]);
+    }
+
+    for (auto const& data: value) {
+        serialize(stream, data);
+    }
+}
+
+// Appends count encoded elements to value, numeric elements are read in bulk.
+template<class T, class S>
+bool readElements(S& stream, T& value, size_t count) noexcept {
+    using Element = typename T::value_type;
+    if constexpr (isBulkElement<T>) {
+        auto const offset = value.size();
+        value.resize(offset + count);
+        auto const bytes = static_cast<std::streamsize>(count * sizeof(Element));
+        stream.read(reinterpret_cast<typename S::char_type*>(value.data() + offset), bytes);
+        return stream.gcount() == bytes;
+    } else {
+        value.reserve(value.size() + count);
+        for (size_t i = 0; i < count; ++i) {
+            auto data = deserialize<Element>(stream);
+            if (not data.has_value()) {
+                return false;
+            }
+            value.push_back(std::move(*data));
+        }
+        return true;
+    }
+}
+
+template<class T, class S>
+bool skipElements(S& stream, size_t count) noexcept {
+    using Element = typename T::value_type;
+    if constexpr (isNumeric<Element>) {
+        return skipBytes(stream, count * sizeof(Element));
+    } else {
+        for (size_t i = 0; i < count; ++i) {
+            if (not skip<Element>(stream)) {
+                return false;
+            }
+        }
+        return true;
+    }
+}
+
+template<class T, class S>
+std::enable_if_t<isContiguous<T>, std::optional<T>> deserializeChunked(S& stream) noexcept {
+    assertTypes<S, T>();
+    auto const size = deserialize<typename T::size_type>(stream);
+    auto const chunkElements = deserialize<uint64_t>(stream);
+    if (not size.has_value() or not chunkElements.has_value()
+        or not skipBytes(stream, chunksCount(*size, *chunkElements) * sizeof(uint64_t))) {
+        return std::nullopt;
+    }
+
+    T value;
+    if (not readElements(stream, value, *size)) {
+        return std::nullopt;
+    }
+    return value;
+}
+
+// Elements [begin, end) of a chunked vector, end is clamped to its size.
+template<class T, class S>
+std::enable_if_t<isContiguous<T>, std::optional<T>> deserializeChunkedRange(S& stream, size_t begin, size_t end) noexcept {
+    assertTypes<S, T>();
+    auto const size = deserialize<typename T::size_type>(stream);
+    auto const chunkElements = deserialize<uint64_t>(stream);
+    if (not size.has_value() or not chunkElements.has_value() or *chunkElements == 0) {
+        return std::nullopt;
+    }
+
+    end = std::min<size_t>(end, *size);
+    T value;
+    if (begin >= end) {
+        return value;
+    }
+
+    auto const chunks = chunksCount(*size, *chunkElements);
+    auto const chunk = begin / *chunkElements;
+    if (not skipBytes(stream, chunk * sizeof(uint64_t))) {
+        return std::nullopt;
+    }
+
+    auto const offset = deserialize<uint64_t>(stream);
+    if (not offset.has_value() or not skipBytes(stream, (chunks - chunk - 1) * sizeof(uint64_t) + *offset)) {
+        return std::nullopt;
+    }
+
+    if (not skipElements<T>(stream, begin - chunk * *chunkElements) or not readElements(stream, value, end - begin)) {
+        return std::nullopt;
+    }
+    return value;
+}
+
+// Elements [begin, end) of a vector in the plain encoding, preceding numeric
+// elements are seeked over, others are skipped one by one.
+template<class T, class S>
+std::enable_if_t<isContiguous<T>, std::optional<T>> deserializeRange(S& stream, size_t begin, size_t end) noexcept {
+    assertTypes<S, T>();
+    auto const size = deserialize<typename T::size_type>(stream);
+    if (not size.has_value()) {
+        return std::nullopt;
+    }
+
+    end = std::min<size_t>(end, *size);
+    T value;
+    if (begin >= end) {
+        return value;
+    }
+
+    if (not skipElements<T>(stream, begin) or not readElements(stream, value, end - begin)) {
+        return std::nullopt;
+    }
+    return value;
+}
+
+} // namespace binary_storage::serde
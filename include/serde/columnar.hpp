@@ -0,0 +1,174 @@
+#pragma once
+
+#include <optional>
+#include <tuple>
+#include <vector>
+
+#include "serde.hpp"
+#include "chunked.hpp"
+
+namespace binary_storage::serde {
+
+// Columnar encoding of a vector of reflectable records: the record count,
+// then every member of all records as one contiguous column, in declaration
+// order. Numeric columns are copied as single blocks of memory, other columns
+// hold the members encoded one after another. The total size is the same as
+// the one of the plain encoding.
+
+template<class T, class = void>
+struct RecordVector : std::false_type {};
+
+template<class T>
+struct RecordVector<T, std::enable_if_t<isContiguous<T>>> : std::bool_constant<isReflectable<typename T::value_type>> {};
+
+template<class T>
+static bool constexpr isRecordVector = RecordVector<T>::value;
+
+template<auto... Members>
+using Columns = std::tuple<std::vector<MemberType<Members>>...>;
+
+template<class S, class T>
+std::enable_if_t<isRecordVector<T>, void> serializeColumnar(S& stream, T const& value) noexcept {
+    using Record = typename T::value_type;
+    assertTypes<S, T>();
+    serialize(stream, value.size());
+
+    for_each(refl::reflect<Record>().members, [&] (auto member) {
+        using Member = typename decltype(member)::value_type;
+        if constexpr (isBulkElement<std::vector<Member>>) {
+            std::vector<Member> column;
+            column.reserve(value.size());
+            for (auto const& record: value) {
+                column.push_back(member(record));
+            }
+            stream.write(reinterpret_cast<typename S::char_type const*>(column.data()),
+                         static_cast<std::streamsize>(column.size() * sizeof(Member)));
+        } else {
+            for (auto const& record: value) {
+                serialize(stream, member(record));
+            }
+        }
+    });
+}
+
+// Reads a column of count members, numeric ones in bulk.
+template<class Member, class S>
+std::optional<std::vector<Member>> readColumn(S& stream, size_t count) noexcept {
+    std::vector<Member> column;
+    if (not readElements(stream, column, count)) {
+        return std::nullopt;
+    }
+    return column;
+}
+
+template<class T, class S>
+std::enable_if_t<isRecordVector<T>, std::optional<T>> deserializeColumnar(S& stream) noexcept {
+    using Record = typename T::value_type;
+    assertTypes<S, T>();
+    auto const size = deserialize<typename T::size_type>(stream);
+    if (not size.has_value()) {
+        return std::nullopt;
+    }
+
+    T value(*size);
+    bool error {false};
+    for_each(refl::reflect<Record>().members, [&] (auto member) {
+        using Member = typename decltype(member)::value_type;
+        if (error) {
+            return;
+        }
+
+        auto column = readColumn<Member>(stream, *size);
+        if (not column.has_value()) {
+            error = true;
+            return;
+        }
+
+        for (size_t i = 0; i < *size; ++i) {
+            member(value[i]) = std::move((*column)[i]);
+        }
+    });
+
+    if (error) {
+        return std::nullopt;
+    }
+
+    return value;
+}
+
+// Decodes only the columns of the given distinct members, the other columns
+// are skipped and decoding stops after the last requested one.
+template<auto... Members, class S>
+static std::optional<Columns<Members...>> deserializeColumns(S& stream) noexcept {
+    using Record = ProjectionClass<Members...>;
+    assertProjection<Members...>();
+    assertTypes<S, Record>();
+    auto const size = deserialize<typename std::vector<Record>::size_type>(stream);
+    if (not size.has_value()) {
+        return std::nullopt;
+    }
+
+    Columns<Members...> result;
+    size_t remaining = sizeof...(Members);
+    bool error {false};
+
+    for_each(refl::reflect<Record>().members, [&] (auto member) {
+        using Member = typename decltype(member)::value_type;
+        constexpr auto index = memberIndex<decltype(member)::pointer, Members...>();
+        if (error or remaining == 0) {
+            return;
+        }
+
+        if constexpr (index < sizeof...(Members)) {
+            auto column = readColumn<Member>(stream, *size);
+            if (not column.has_value()) {
+                error = true;
+                return;
+            }
+
+            std::get<index>(result) = std::move(*column);
+            --remaining;
+        } else {
+            error = not skipElements<std::vector<Member>>(stream, *size);
+        }
+    });
+
+    if (error) {
+        return std::nullopt;
+    }
+
+    return result;
+}
+
+template<class C, class P, size_t... I>
+void appendFields(C& columns, P&& fields, std::index_sequence<I...>) {
+    (std::get<I>(columns).push_back(std::move(std::get<I>(fields))), ...);
+}
+
+// The same columns read from a vector in the plain, record by record encoding.
+template<auto... Members, class S>
+static std::optional<Columns<Members...>> deserializeColumnsFromRows(S& stream) noexcept {
+    using Record = ProjectionClass<Members...>;
+    assertProjection<Members...>();
+    assertTypes<S, Record>();
+    auto const size = deserialize<typename std::vector<Record>::size_type>(stream);
+    if (not size.has_value()) {
+        return std::nullopt;
+    }
+
+    Columns<Members...> result;
+    std::apply([&] (auto&... columns) { (columns.reserve(*size), ...); }, result);
+
+    Projection<Members...> fields;
+    for (size_t i = 0; i < *size; ++i) {
+        if (not readFields<Members...>(stream, fields, true)) {
+            return std::nullopt;
+        }
+
+        appendFields(result, std::move(fields), std::index_sequence_for<decltype(Members)...> {});
+    }
+
+    return result;
+}
+
+} // namespace binary_storage::serde
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <climits>
+#include <functional>
+#include <type_traits>
+#include <vector>
+
+#include "serde.hpp"
+
+namespace binary_storage::serde {
+
+// Memory held by a value: its own size plus everything it owns on the heap,
+// counted by capacity rather than by size. Containers without a capacity,
+// such as std::deque and std::list, are counted by size and leave out their
+// blocks or nodes. Strings short enough to live in the object itself own no
+// heap memory. Allocator overhead is not included.
+
+template<class T>
+static size_t heapFootprint(T const& value) noexcept;
+
+template<class T>
+size_t allocatedElements(T const& value) noexcept {
+    if constexpr (isContiguous<T>) {
+        return value.capacity();
+    } else {
+        return value.size();
+    }
+}
+
+template<class T>
+std::enable_if_t<isNumeric<T>, size_t> heapFootprintImpl(T const&) noexcept {
+    return 0;
+}
+
+template<class T>
+std::enable_if_t<isVector<T>, size_t> heapFootprintImpl(T const& value) noexcept {
+    using Element = typename T::value_type;
+    if constexpr (std::is_same_v<T, std::vector<bool>>) {
+        return (value.capacity() + CHAR_BIT - 1) / CHAR_BIT;
+    } else {
+        auto size = allocatedElements(value) * sizeof(Element);
+        if constexpr (not isNumeric<Element>) {
+            for (auto const& data: value) {
+                size += heapFootprint(data);
+            }
+        }
+        return size;
+    }
+}
+
+template<class T>
+std::enable_if_t<isString<T>, size_t> heapFootprintImpl(T const& value) noexcept {
+    auto const data = reinterpret_cast<char const*>(value.data());
+    auto const object = reinterpret_cast<char const*>(&value);
+    auto const inside = not std::less<char const*> {}(data, object) and std::less<char const*> {}(data, object + sizeof(T));
+    return inside ? 0 : (value.capacity() + 1) * sizeof(typename T::value_type);
+}
+
+template<class T>
+std::enable_if_t<isReflectable<T>, size_t> heapFootprintImpl(T const& value) noexcept {
+    size_t size = 0;
+    for_each(refl::reflect(value).members, [&] (auto member) {
+        size += heapFootprint(member(value));
+    });
+    return size;
+}
+
+// Heap memory owned by the value, without the value itself.
+template<class T>
+static size_t heapFootprint(T const& value) noexcept {
+    static_assert(isSerializeble<T>, "T parameter must be a serializeble");
+    return heapFootprintImpl(value);
+}
+
+template<class T>
+static size_t memoryFootprint(T const& value) noexcept {
+    return sizeof(T) + heapFootprint(value);
+}
+
+} // namespace binary_storage::serde
@@ -0,0 +1,198 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <iterator>
+#include <optional>
+#include <sstream>
+#include <streambuf>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "chunked.hpp"
+
+namespace binary_storage::serde {
+
+// Parallel form of the chunked vector encoding. A chunk depends only on its
+// own elements, so chunks are encoded into separate buffers and decoded from
+// their own byte ranges concurrently; the bytes are the same serializeChunked
+// writes. The work is spread by a parallelFor(count, task) callable that runs
+// task(i) once for every i in [0, count) and returns when all are done.
+using ParallelFor = std::function<void(size_t, std::function<void(size_t)> const&)>;
+
+// Read-only stream buffer over memory it does not own.
+class ViewBuffer : public std::streambuf {
+   public:
+    explicit ViewBuffer(std::string_view bytes) noexcept {
+        auto const data = const_cast<char*>(bytes.data());
+        setg(data, data, data + bytes.size());
+    }
+
+   protected:
+    pos_type seekoff(off_type offset, std::ios_base::seekdir direction, std::ios_base::openmode which) override {
+        if ((which & std::ios_base::in) == 0) {
+            return pos_type(off_type(-1));
+        }
+
+        auto const base = direction == std::ios_base::beg   ? off_type(0)
+                          : direction == std::ios_base::cur ? off_type(gptr() - eback())
+                                                            : off_type(egptr() - eback());
+        auto const position = base + offset;
+        if (position < 0 or position > off_type(egptr() - eback())) {
+            return pos_type(off_type(-1));
+        }
+        setg(eback(), eback() + position, egptr());
+        return pos_type(position);
+    }
+
+    pos_type seekpos(pos_type position, std::ios_base::openmode which) override {
+        return seekoff(off_type(position), std::ios_base::beg, which);
+    }
+};
+
+class ViewStream : public std::istream {
+   public:
+    explicit ViewStream(std::string_view bytes) :
+        std::istream(nullptr),
+        m_buffer {bytes} {
+        rdbuf(&m_buffer);
+    }
+
+   private:
+    ViewBuffer m_buffer;
+};
+
+// The chunked encoding split at chunk boundaries: the header with the element
+// count, the chunk size and the offsets table, then every chunk on its own.
+struct ChunkedBuffers {
+    std::string header;
+    std::vector<std::string> chunks;
+
+    size_t size() const noexcept {
+        auto result = header.size();
+        for (auto const& chunk: chunks) {
+            result += chunk.size();
+        }
+        return result;
+    }
+};
+
+template<class T>
+std::enable_if_t<isContiguous<T>, ChunkedBuffers> encodeChunkedParallel(T const& value, size_t chunkElements, ParallelFor const& parallelFor) {
+    using Element = typename T::value_type;
+    chunkElements = std::max<size_t>(chunkElements, 1);
+
+    ChunkedBuffers result;
+    result.chunks.resize(chunksCount(value.size(), chunkElements));
+    parallelFor(result.chunks.size(), [&] (size_t chunk) {
+        auto const begin = chunk * chunkElements;
+        auto const end = std::min(begin + chunkElements, value.size());
+        if constexpr (isBulkElement<T>) {
+            result.chunks[chunk].assign(reinterpret_cast<char const*>(value.data() + begin), (end - begin) * sizeof(Element));
+        } else {
+            std::ostringstream stream;
+            for (auto i = begin; i < end; ++i) {
+                serialize(stream, value[i]);
+            }
+            result.chunks[chunk] = stream.str();
+        }
+    });
+
+    std::ostringstream header;
+    serialize(header, value.size());
+    serialize(header, static_cast<uint64_t>(chunkElements));
+    uint64_t offset = 0;
+    for (auto const& chunk: result.chunks) {
+        serialize(header, offset);
+        offset += chunk.size();
+    }
+    result.header = header.str();
+    return result;
+}
+
+template<class S, class T>
+std::enable_if_t<isContiguous<T>, void> serializeChunkedParallel(S& stream, T const& value, size_t chunkElements, ParallelFor const& parallelFor) {
+    assertTypes<S, T>();
+    auto const buffers = encodeChunkedParallel(value, chunkElements, parallelFor);
+    stream.write(buffers.header.data(), static_cast<std::streamsize>(buffers.header.size()));
+    for (auto const& chunk: buffers.chunks) {
+        stream.write(chunk.data(), static_cast<std::streamsize>(chunk.size()));
+    }
+}
+
+// Decodes the chunks straight from the bytes, numeric elements are copied
+// into place, others are decoded per chunk and joined in order.
+template<class T>
+std::enable_if_t<isContiguous<T>, std::optional<T>> deserializeChunkedParallel(std::string_view bytes, ParallelFor const& parallelFor) {
+    ViewStream stream(bytes);
+    auto const size = deserialize<typename T::size_type>(stream);
+    auto const chunkElements = deserialize<uint64_t>(stream);
+    if (not size.has_value() or not chunkElements.has_value() or *chunkElements == 0) {
+        return std::nullopt;
+    }
+
+    auto const chunks = chunksCount(*size, *chunkElements);
+    auto const headerSize = sizeof(typename T::size_type) + sizeof(uint64_t) + chunks * sizeof(uint64_t);
+    if (chunks > bytes.size() / sizeof(uint64_t) or headerSize > bytes.size()) {
+        return std::nullopt;
+    }
+
+    auto const data = bytes.substr(headerSize);
+    std::vector<uint64_t> offsets(chunks + 1, data.size());
+    for (size_t chunk = 0; chunk < chunks; ++chunk) {
+        auto const offset = deserialize<uint64_t>(stream);
+        if (not offset.has_value() or *offset > data.size() or (chunk != 0 and *offset < offsets[chunk - 1])) {
+            return std::nullopt;
+        }
+        offsets[chunk] = *offset;
+    }
+
+    auto const elements = [&] (size_t chunk) {
+        return std::min<size_t>(*chunkElements, *size - chunk * *chunkElements);
+    };
+
+    T value;
+    std::atomic<bool> failed {false};
+    if constexpr (isBulkElement<T>) {
+        using Element = typename T::value_type;
+        if (*size > data.size() / sizeof(Element)) {
+            return std::nullopt;
+        }
+
+        value.resize(*size);
+        parallelFor(chunks, [&] (size_t chunk) {
+            auto const count = elements(chunk) * sizeof(Element);
+            if (offsets[chunk] + count > data.size()) {
+                failed = true;
+                return;
+            }
+            std::memcpy(value.data() + chunk * *chunkElements, data.data() + offsets[chunk], count);
+        });
+    } else {
+        std::vector<T> parts(chunks);
+        parallelFor(chunks, [&] (size_t chunk) {
+            ViewStream part(data.substr(offsets[chunk], offsets[chunk + 1] - offsets[chunk]));
+            if (not readElements(part, parts[chunk], elements(chunk))) {
+                failed = true;
+            }
+        });
+
+        if (not failed) {
+            value.reserve(*size);
+            for (auto& part: parts) {
+                value.insert(value.end(), std::make_move_iterator(part.begin()), std::make_move_iterator(part.end()));
+            }
+        }
+    }
+
+    if (failed) {
+        return std::nullopt;
+    }
+    return value;
+}
+
+} // namespace binary_storage::serde
@@ -1,6 +1,8 @@
 #pragma once
 
+#include <limits>
 #include <optional>
+#include <tuple>
 
 #include "traits.hpp"
 
@@ -15,6 +17,12 @@ static void serialize(S& stream, T const& value) noexcept;
 template<class T, class S>
 static std::optional<T> deserialize(S& stream) noexcept;
 
+template<class T>
+static size_t serializedSize(T const& value) noexcept;
+
+template<class T, class S>
+static bool skip(S& stream) noexcept;
+
 template<class S, class T>
 std::enable_if_t<isNumeric<T>, void> serializeImpl(S& stream, T const& value) noexcept {
     auto constexpr size = sizeof(T);
@@ -62,6 +70,45 @@ static void serialize(S& stream, T const& value) noexcept {
     serializeImpl(stream, value);
 }
 
+template<class T>
+std::enable_if_t<isNumeric<T>, size_t> serializedSizeImpl(T const&) noexcept {
+    return sizeof(T);
+}
+
+template<class T>
+std::enable_if_t<isVector<T>, size_t> serializedSizeImpl(T const& value) noexcept {
+    if constexpr (isNumeric<typename T::value_type>) {
+        return sizeof(typename T::size_type) + value.size() * sizeof(typename T::value_type);
+    } else {
+        auto size = sizeof(typename T::size_type);
+        for (auto const& data: value) {
+            size += serializedSize(data);
+        }
+        return size;
+    }
+}
+
+template<class T>
+std::enable_if_t<isString<T>, size_t> serializedSizeImpl(T const& value) noexcept {
+    return sizeof(typename T::size_type) + value.size();
+}
+
+template<class T>
+std::enable_if_t<isReflectable<T>, size_t> serializedSizeImpl(T const& value) noexcept {
+    size_t size = 0;
+    for_each(refl::reflect(value).members, [&] (auto member) {
+        size += serializedSize(member(value));
+    });
+    return size;
+}
+
+// Number of bytes serialize writes for the value, computed without encoding it.
+template<class T>
+static size_t serializedSize(T const& value) noexcept {
+    static_assert(isSerializeble<T>, "T parameter must be a serializeble");
+    return serializedSizeImpl(value);
+}
+
 template<class T, class S>
 std::enable_if_t<isNumeric<T>, std::optional<T>> deserializeImpl(S& stream) noexcept {
     auto constexpr size = sizeof(T);
@@ -162,4 +209,182 @@ static std::optional<T> deserialize(S& stream) noexcept {
     return deserializeImpl<T>(stream);
 }
 
+// File streams seek past the end without failing, so the last skipped byte is
+// peeked to tell a truncated value from a whole one.
+template<class S>
+bool skipBytes(S& stream, size_t size) noexcept {
+    if (size == 0) {
+        return not stream.fail();
+    }
+    if (size > static_cast<size_t>(std::numeric_limits<typename S::off_type>::max())) {
+        stream.setstate(std::ios_base::failbit);
+        return false;
+    }
+
+    stream.seekg(static_cast<typename S::off_type>(size - 1), std::ios_base::cur);
+    if (stream.fail() or S::traits_type::eq_int_type(stream.peek(), S::traits_type::eof())) {
+        stream.setstate(std::ios_base::failbit);
+        return false;
+    }
+    stream.seekg(1, std::ios_base::cur);
+    return not stream.fail();
+}
+
+template<class T, class S>
+std::enable_if_t<isNumeric<T>, bool> skipImpl(S& stream) noexcept {
+    return skipBytes(stream, sizeof(T));
+}
+
+template<class T, class S>
+std::enable_if_t<isVector<T>, bool> skipImpl(S& stream) noexcept {
+    auto const size = deserialize<typename T::size_type>(stream);
+    if (not size.has_value()) {
+        return false;
+    }
+
+    if constexpr (isNumeric<typename T::value_type>) {
+        return skipBytes(stream, *size * sizeof(typename T::value_type));
+    } else {
+        for (typename T::size_type i = 0; i < *size; ++i) {
+            if (not skip<typename T::value_type>(stream)) {
+                return false;
+            }
+        }
+        return true;
+    }
+}
+
+template<class T, class S>
+std::enable_if_t<isString<T>, bool> skipImpl(S& stream) noexcept {
+    auto const size = deserialize<typename T::size_type>(stream);
+    return size.has_value() and skipBytes(stream, *size);
+}
+
+template<class T, class S>
+std::enable_if_t<isReflectable<T>, bool> skipImpl(S& stream) noexcept {
+    bool ok {true};
+    for_each(refl::reflect<T>().members, [&] (auto member) {
+        using Member = typename decltype(member)::value_type;
+        ok = ok and skip<Member>(stream);
+    });
+    return ok;
+}
+
+// Moves the stream past an encoded T without decoding it, lengths of strings
+// and numeric vectors are used to seek over their contents.
+template<class T, class S>
+static bool skip(S& stream) noexcept {
+    assertTypes<S, T>();
+    return skipImpl<T>(stream);
+}
+
+template<class P>
+struct MemberPointer;
+
+template<class C, class V>
+struct MemberPointer<V C::*> {
+    using Class = C;
+    using Type = V;
+};
+
+template<auto Pointer>
+using MemberClass = typename MemberPointer<decltype(Pointer)>::Class;
+
+template<auto Pointer>
+using MemberType = typename MemberPointer<decltype(Pointer)>::Type;
+
+template<auto Lhs, auto Rhs>
+constexpr bool isSameMember() noexcept {
+    if constexpr (std::is_same_v<decltype(Lhs), decltype(Rhs)>) {
+        return Lhs == Rhs;
+    } else {
+        return false;
+    }
+}
+
+// Position of Pointer in Members, sizeof...(Members) when it is not there.
+template<auto Pointer, auto... Members>
+constexpr size_t memberIndex() noexcept {
+    size_t index = 0;
+    bool found = false;
+    ((found = found or isSameMember<Pointer, Members>(), index += found ? 0 : 1), ...);
+    return index;
+}
+
+// Whether no member is given twice, each is then found at its own position.
+template<auto... Members>
+constexpr bool areDistinct() noexcept {
+    size_t position = 0;
+    bool distinct = true;
+    ((distinct = distinct and memberIndex<Members, Members...>() == position++), ...);
+    return distinct;
+}
+
+template<auto... Members>
+using Projection = std::tuple<MemberType<Members>...>;
+
+template<auto First, auto...>
+struct FirstMember {
+    using Class = MemberClass<First>;
+};
+
+template<auto... Members>
+using ProjectionClass = typename FirstMember<Members...>::Class;
+
+template<auto... Members>
+static inline void assertProjection() noexcept {
+    static_assert(sizeof...(Members) != 0, "At least one member must be requested");
+    static_assert(isReflectable<ProjectionClass<Members...>>, "Members must belong to a reflectable type");
+    static_assert((std::is_same_v<ProjectionClass<Members...>, MemberClass<Members>> and ...),
+                  "Members must belong to the same type");
+    static_assert(areDistinct<Members...>(), "Members must be distinct");
+}
+
+// Reads the requested members of one encoded value into result and skips the
+// others, up to the end of the value or only up to the last requested member.
+template<auto... Members, class S>
+bool readFields(S& stream, Projection<Members...>& result, bool wholeValue) noexcept {
+    using T = ProjectionClass<Members...>;
+    size_t remaining = sizeof...(Members);
+    bool error {false};
+
+    for_each(refl::reflect<T>().members, [&] (auto member) {
+        using Member = typename decltype(member)::value_type;
+        constexpr auto index = memberIndex<decltype(member)::pointer, Members...>();
+        if (error or (remaining == 0 and not wholeValue)) {
+            return;
+        }
+
+        if constexpr (index < sizeof...(Members)) {
+            auto data = deserialize<Member>(stream);
+            if (not data.has_value()) {
+                error = true;
+                return;
+            }
+
+            std::get<index>(result) = std::move(*data);
+            --remaining;
+        } else {
+            error = not skip<Member>(stream);
+        }
+    });
+
+    return not error;
+}
+
+// Decodes only the given distinct members of an encoded reflectable type, the
+// other members are skipped and decoding stops after the last requested one.
+template<auto... Members, class S>
+static std::optional<Projection<Members...>> deserializeFields(S& stream) noexcept {
+    assertProjection<Members...>();
+    assertTypes<S, ProjectionClass<Members...>>();
+
+    Projection<Members...> result;
+    if (not readFields<Members...>(stream, result, false)) {
+        return std::nullopt;
+    }
+
+    return result;
+}
+
 } // namespace binary_storage::serde
@@ -32,6 +32,19 @@ static auto constexpr isVector = [] () constexpr -> bool {
     return hasContainerTraits<T> and not isString<T>;
 }();
 
+// Vectors that reserve their storage up front and index it in constant time,
+// std::vector but not std::deque or std::list. Only these take the chunked
+// and columnar encodings and the bulk element copies.
+template<class T, class = void>
+struct ContiguousVector : std::false_type {};
+
+template<class T>
+struct ContiguousVector<T, std::void_t<decltype(std::declval<T const&>().capacity()), decltype(std::declval<T&>().reserve(0))>>
+    : std::bool_constant<isVector<T>> {};
+
+template<class T>
+static bool constexpr isContiguous = ContiguousVector<T>::value;
+
 template<class T>
 static auto constexpr isOutStream = [] () constexpr -> bool {
     return std::is_base_of_v<std::ostream, T>;
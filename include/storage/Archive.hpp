@@ -0,0 +1,174 @@
+#pragma once
+
+#include <cstdint>
+#include <fstream>
+#include <istream>
+#include <memory>
+#include <optional>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+#include "serde/traits.hpp"
+#include "serde/serde.hpp"
+#include "ValueStorage.hpp"
+
+namespace binary_storage::storage {
+
+// Single-file archive of encoded values: a header with the number of entries
+// and the layout of the values, then one entry per key with the key and the
+// value encoded as in its file, then an end marker.
+namespace archive {
+
+inline constexpr uint32_t magic {0x52415342};
+inline constexpr uint32_t version {3};
+
+// Archives are read and written through buffers of this size, so the disk sees
+// a few large sequential requests instead of one per entry.
+inline constexpr size_t bufferSize {4 * 1024 * 1024};
+
+enum Marker : uint8_t { End = 0, Entry = 1 };
+
+template<class Stream, std::ios_base::openmode Mode>
+class File : public Stream {
+   public:
+    explicit File(std::string const& path) :
+        m_buffer {new char[bufferSize]} {
+        this->rdbuf()->pubsetbuf(m_buffer.get(), bufferSize);
+        this->open(path, Mode);
+    }
+
+    // The buffer must outlive the final flush of the stream.
+    ~File() {
+        this->close();
+    }
+
+   private:
+    std::unique_ptr<char[]> m_buffer;
+};
+
+using OutputFile = File<std::ofstream, std::ios::binary | std::ios::trunc>;
+using InputFile = File<std::ifstream, std::ios::binary>;
+
+enum Format : uint8_t { Plain = 0, Chunked = 1, Columnar = 2 };
+
+// What a payload must be decoded as: the encoding of the value files and a
+// tag of the value type. The chunk size is not part of it, every chunked
+// value records its own.
+struct Layout {
+    uint8_t format {Plain};
+    uint64_t type {0};
+
+    bool operator==(Layout const& other) const noexcept {
+        return format == other.format and type == other.type;
+    }
+
+    bool operator!=(Layout const& other) const noexcept {
+        return not (*this == other);
+    }
+};
+
+// Structure of T as the encoding sees it: the kind and size of numbers and
+// the nesting of strings, vectors and members. Member names are left out.
+template<class T>
+void appendTypeSignature(std::string& signature) {
+    if constexpr (std::is_same_v<T, bool>) {
+        signature += 'b';
+    } else if constexpr (serde::isNumeric<T>) {
+        signature += std::is_floating_point_v<T> ? 'f' : std::is_signed_v<T> ? 'i' : 'u';
+        signature += std::to_string(sizeof(T));
+    } else if constexpr (serde::isString<T>) {
+        signature += 's';
+    } else if constexpr (serde::isVector<T>) {
+        signature += '[';
+        appendTypeSignature<typename T::value_type>(signature);
+        signature += ']';
+    } else {
+        signature += '{';
+        for_each(refl::reflect<T>().members, [&] (auto member) {
+            appendTypeSignature<typename decltype(member)::value_type>(signature);
+        });
+        signature += '}';
+    }
+}
+
+// FNV-1a of the type signature, the same on every platform and compiler.
+template<class T>
+uint64_t typeTag() {
+    std::string signature;
+    appendTypeSignature<T>(signature);
+    uint64_t hash = 0xcbf29ce484222325ull;
+    for (auto const c: signature) {
+        hash = (hash ^ static_cast<uint8_t>(c)) * 0x100000001b3ull;
+    }
+    return hash;
+}
+
+template<class T>
+Layout layoutOf(Encoding const& encoding) {
+    auto const format = isColumnar<T>(encoding) ? Columnar : isChunked<T>(encoding) ? Chunked : Plain;
+    return {format, typeTag<T>()};
+}
+
+struct Header {
+    uint64_t entries {0};
+    Layout layout;
+};
+
+inline void writeHeader(std::ostream& stream, uint64_t entries, Layout const& layout) {
+    serde::serialize(stream, magic);
+    serde::serialize(stream, version);
+    serde::serialize(stream, entries);
+    serde::serialize(stream, layout.format);
+    serde::serialize(stream, layout.type);
+}
+
+// Returns std::nullopt when the stream is not an archive of this version.
+inline std::optional<Header> readHeader(std::istream& stream) {
+    auto const fileMagic = serde::deserialize<uint32_t>(stream);
+    auto const fileVersion = serde::deserialize<uint32_t>(stream);
+    auto const entries = serde::deserialize<uint64_t>(stream);
+    auto const format = serde::deserialize<uint8_t>(stream);
+    auto const type = serde::deserialize<uint64_t>(stream);
+    if (fileMagic != magic or fileVersion != version or not entries.has_value() or not format.has_value()
+        or not type.has_value()) {
+        return std::nullopt;
+    }
+    return Header {*entries, Layout {*format, *type}};
+}
+
+inline void writeEntry(std::ostream& stream, std::string const& key, std::string const& payload) {
+    serde::serialize(stream, static_cast<uint8_t>(Entry));
+    serde::serialize(stream, key);
+    serde::serialize(stream, payload.size());
+    stream.write(payload.data(), static_cast<std::streamsize>(payload.size()));
+}
+
+inline void writeEnd(std::ostream& stream) {
+    serde::serialize(stream, static_cast<uint8_t>(End));
+}
+
+// Returns std::nullopt at the end marker, throws on a truncated archive.
+inline std::optional<std::pair<std::string, std::string>> readEntry(std::istream& stream) {
+    auto const marker = serde::deserialize<uint8_t>(stream);
+    if (marker == static_cast<uint8_t>(End)) {
+        return std::nullopt;
+    }
+
+    auto key = serde::deserialize<std::string>(stream);
+    auto const size = serde::deserialize<size_t>(stream);
+    if (marker != static_cast<uint8_t>(Entry) or not key.has_value() or not size.has_value()) {
+        throw std::logic_error("Invalid archive");
+    }
+
+    std::string payload(*size, '\0');
+    if (not stream.read(payload.data(), static_cast<std::streamsize>(payload.size()))) {
+        throw std::logic_error("Invalid archive");
+    }
+    return std::make_pair(std::move(*key), std::move(payload));
+}
+
+} // namespace archive
+
+} // namespace binary_storage::storage
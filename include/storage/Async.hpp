@@ -0,0 +1,140 @@
+#pragma once
+
+#if defined(__cpp_impl_coroutine) && __has_include(<coroutine>)
+#define BINARY_STORAGE_COROUTINES 1
+
+#include <atomic>
+#include <coroutine>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <type_traits>
+#include <utility>
+
+namespace binary_storage::storage {
+
+// Runs the continuation of a suspended coroutine. An empty executor resumes
+// inline on the thread that completed the disk operation.
+using Executor = std::function<void(std::function<void()>)>;
+
+template<class R>
+class AsyncState {
+   public:
+    using Result = std::conditional_t<std::is_reference_v<R>, std::remove_reference_t<R>*, R>;
+
+   public:
+    explicit AsyncState(Executor executor) :
+        m_executor {std::move(executor)} {}
+
+    template<class U>
+    void setValue(U&& value) {
+        if constexpr (std::is_reference_v<R>) {
+            m_result = &value;
+        } else {
+            m_result = std::forward<U>(value);
+        }
+        finish();
+    }
+
+    void setException(std::exception_ptr exception) {
+        m_exception = std::move(exception);
+        finish();
+    }
+
+    bool suspend(std::coroutine_handle<> continuation) noexcept {
+        m_continuation = continuation;
+        auto expected = Pending;
+        return m_status.compare_exchange_strong(expected, Suspended, std::memory_order_acq_rel);
+    }
+
+    bool completed() const noexcept {
+        return m_status.load(std::memory_order_acquire) == Completed;
+    }
+
+    R result() {
+        if (m_exception) {
+            std::rethrow_exception(m_exception);
+        }
+
+        if constexpr (std::is_reference_v<R>) {
+            return **m_result;
+        } else {
+            return std::move(*m_result);
+        }
+    }
+
+   private:
+    enum Status { Pending, Suspended, Completed };
+
+    std::optional<Result> m_result;
+    std::exception_ptr m_exception;
+    std::coroutine_handle<> m_continuation;
+    std::atomic<Status> m_status {Pending};
+    Executor m_executor;
+
+   private:
+    void finish() {
+        if (m_status.exchange(Completed, std::memory_order_acq_rel) != Suspended) {
+            return;
+        }
+
+        if (m_executor) {
+            m_executor([continuation = m_continuation] { continuation.resume(); });
+        } else {
+            m_continuation.resume();
+        }
+    }
+};
+
+template<>
+class AsyncState<void> : public AsyncState<bool> {
+   public:
+    using AsyncState<bool>::AsyncState;
+
+    void setValue() {
+        AsyncState<bool>::setValue(true);
+    }
+
+    void result() {
+        AsyncState<bool>::result();
+    }
+};
+
+// Awaitable result of an asynchronous Storage operation. Results that are
+// available immediately complete without suspending the awaiting coroutine.
+template<class R>
+class Async {
+   public:
+    using State = AsyncState<R>;
+
+   public:
+    explicit Async(std::shared_ptr<State> state) :
+        m_state {std::move(state)} {}
+
+    template<class... Args>
+    static Async ready(Args&&... args) {
+        auto state = std::make_shared<State>(Executor {});
+        state->setValue(std::forward<Args>(args)...);
+        return Async(std::move(state));
+    }
+
+    bool await_ready() const noexcept {
+        return m_state->completed();
+    }
+
+    bool await_suspend(std::coroutine_handle<> continuation) noexcept {
+        return m_state->suspend(continuation);
+    }
+
+    R await_resume() {
+        return m_state->result();
+    }
+
+   private:
+    std::shared_ptr<State> m_state;
+};
+
+} // namespace binary_storage::storage
+
+#endif
@@ -1,21 +1,52 @@
 #pragma once
 
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
 #include <future>
+#include <mutex>
 
 #include "Storage.hpp"
 
 namespace binary_storage::storage {
 
+// Storage with a background task that every backgroundInterval erases the
+// expired entries and fits the resident set to the cache limits.
 template<class T>
 class AutoStorage {
    public:
     using ValueType = T;
     using StorageType = Storage<ValueType>;
 
+   public:
+    explicit AutoStorage(BaseParameters params) :
+        m_interval {params.backgroundInterval},
+        m_storage {std::move(params)} {
+        m_fitSizeFuture = std::async(std::launch::async, [this] { fitSizeTask(); }).share();
+    }
+
+    AutoStorage(AutoStorage const&) = delete;
+    AutoStorage(AutoStorage&&) noexcept = delete;
+    AutoStorage& operator=(AutoStorage const&) = delete;
+    AutoStorage& operator=(AutoStorage&&) noexcept = delete;
+
+    ~AutoStorage() noexcept {
+        {
+            std::lock_guard lock(m_mutex);
+            m_stoped = true;
+        }
+        m_condition.notify_all();
+        m_fitSizeFuture.wait();
+    }
+
    public:
     void store(std::string const& key, T&& value) {
         m_storage.store(key, std::forward<T>(value));
-    } 
+    }
+
+    void store(std::string const& key, T&& value, std::chrono::milliseconds ttl) {
+        m_storage.store(key, std::forward<T>(value), ttl);
+    }
 
     T& load(std::string const& key) {
         return m_storage.load(key);
@@ -34,13 +65,25 @@ class AutoStorage {
     }
 
    private:
+    std::chrono::milliseconds m_interval;
     StorageType m_storage;
     std::shared_future<void> m_fitSizeFuture;
     std::atomic_bool m_stoped {false};
+    std::mutex m_mutex;
+    std::condition_variable m_condition;
 
    private:
     void fitSizeTask() noexcept {
-        
+        std::unique_lock lock(m_mutex);
+        while (not m_condition.wait_for(lock, m_interval, [this] { return m_stoped.load(); })) {
+            lock.unlock();
+            try {
+                m_storage.expire();
+                m_storage.fitSize();
+            } catch (...) {
+            }
+            lock.lock();
+        }
     }
 };
 
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <optional>
+#include <string>
+
+#if defined(BINARY_STORAGE_WITH_ZLIB)
+#include <zlib.h>
+#endif
+
+namespace binary_storage::storage {
+
+inline constexpr bool compressionAvailable() noexcept {
+#if defined(BINARY_STORAGE_WITH_ZLIB)
+    return true;
+#else
+    return false;
+#endif
+}
+
+// Returns std::nullopt when compression is unavailable or does not pay off.
+inline std::optional<std::string> compress(std::string const& data) {
+#if defined(BINARY_STORAGE_WITH_ZLIB)
+    auto size = compressBound(static_cast<uLong>(data.size()));
+    std::string result(size, '\0');
+    auto const status = compress2(reinterpret_cast<Bytef*>(result.data()),
+                                  &size,
+                                  reinterpret_cast<Bytef const*>(data.data()),
+                                  static_cast<uLong>(data.size()),
+                                  Z_BEST_SPEED);
+    if (status != Z_OK or size >= data.size()) {
+        return std::nullopt;
+    }
+
+    result.resize(size);
+    result.shrink_to_fit();
+    return result;
+#else
+    (void)data;
+    return std::nullopt;
+#endif
+}
+
+inline std::optional<std::string> decompress(std::string const& data, size_t size) {
+#if defined(BINARY_STORAGE_WITH_ZLIB)
+    std::string result(size, '\0');
+    auto resultSize = static_cast<uLongf>(size);
+    auto const status = uncompress(reinterpret_cast<Bytef*>(result.data()),
+                                   &resultSize,
+                                   reinterpret_cast<Bytef const*>(data.data()),
+                                   static_cast<uLong>(data.size()));
+    if (status != Z_OK or resultSize != size) {
+        return std::nullopt;
+    }
+
+    return result;
+#else
+    (void)data;
+    (void)size;
+    return std::nullopt;
+#endif
+}
+
+} // namespace binary_storage::storage
@@ -0,0 +1,112 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <istream>
+#include <iterator>
+#include <optional>
+#include <ostream>
+
+#include "serde/traits.hpp"
+#include "serde/serde.hpp"
+
+namespace binary_storage::storage {
+
+// Log of changes to a vector value that are not in its file yet: a sequence of
+// records, each a kind, the offset for patches and the elements encoded as a
+// plain vector. Records are only ever appended, a record cut short by a crash
+// at the end of the log is ignored and cut off when the log is reopened.
+namespace delta {
+
+enum Kind : uint8_t { Append = 1, Patch = 2 };
+
+template<class T>
+void writeAppend(std::ostream& stream, T const& elements) {
+    serde::serialize(stream, static_cast<uint8_t>(Append));
+    serde::serialize(stream, elements);
+}
+
+template<class T>
+void writePatch(std::ostream& stream, uint64_t offset, T const& elements) {
+    serde::serialize(stream, static_cast<uint8_t>(Patch));
+    serde::serialize(stream, offset);
+    serde::serialize(stream, elements);
+}
+
+template<class T>
+size_t appendSize(T const& elements) noexcept {
+    return sizeof(uint8_t) + serde::serializedSize(elements);
+}
+
+template<class T>
+size_t patchSize(T const& elements) noexcept {
+    return sizeof(uint8_t) + sizeof(uint64_t) + serde::serializedSize(elements);
+}
+
+// Calls visit(offset, elements) for every complete record, offset is
+// std::nullopt for appends. Returns false for a record of an unknown kind.
+template<class T, class F>
+bool forEach(std::istream& stream, F&& visit) {
+    while (stream.peek() != std::istream::traits_type::eof()) {
+        auto const kind = serde::deserialize<uint8_t>(stream);
+        std::optional<uint64_t> offset;
+        if (kind == static_cast<uint8_t>(Patch)) {
+            offset = serde::deserialize<uint64_t>(stream);
+            if (not offset.has_value() or stream.fail()) {
+                return true;
+            }
+        } else if (kind != static_cast<uint8_t>(Append)) {
+            return false;
+        }
+
+        auto elements = serde::deserialize<T>(stream);
+        if (not elements.has_value() or stream.fail()) {
+            return true;
+        }
+        visit(offset, std::move(*elements));
+    }
+    return true;
+}
+
+// Applies the records to the value, false for a malformed log or a patch
+// outside of the value.
+template<class T>
+bool apply(std::istream& stream, T& value) {
+    bool valid = true;
+    auto const known = forEach<T>(stream, [&] (std::optional<uint64_t> offset, T&& elements) {
+        if (not offset.has_value()) {
+            value.insert(value.end(), std::make_move_iterator(elements.begin()), std::make_move_iterator(elements.end()));
+        } else if (*offset <= value.size() and elements.size() <= value.size() - *offset) {
+            std::move(elements.begin(), elements.end(), value.begin() + static_cast<std::ptrdiff_t>(*offset));
+        } else {
+            valid = false;
+        }
+    });
+    return known and valid;
+}
+
+// Length of a value of the given length after the complete records, and the
+// bytes they take. A record torn by a crash starts right after those bytes.
+struct Extent {
+    size_t length;
+    size_t bytes;
+};
+
+template<class T>
+std::optional<Extent> extent(std::istream& stream, size_t length) {
+    size_t bytes = 0;
+    auto const known = forEach<T>(stream, [&] (std::optional<uint64_t> offset, T&& elements) {
+        if (offset.has_value()) {
+            bytes += patchSize(elements);
+        } else {
+            bytes += appendSize(elements);
+            length += elements.size();
+        }
+    });
+    return known ? std::optional<Extent> {Extent {length, bytes}} : std::nullopt;
+}
+
+} // namespace delta
+
+} // namespace binary_storage::storage
@@ -0,0 +1,612 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <future>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <vector>
+
+#include "Parameters.hpp"
+#include "ThreadPool.hpp"
+
+#if defined(BINARY_STORAGE_WITH_IO_URING)
+#include <fcntl.h>
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include <deque>
+#include <mutex>
+#include <thread>
+#endif
+
+namespace binary_storage::storage {
+
+// Asynchronous whole-file reads and writes. Requests are submitted in batches
+// and completed on engine-owned threads through the request callbacks.
+class DiskEngine {
+   public:
+    using ReadCallback = std::function<void(std::optional<std::string>)>;
+    using WriteCallback = std::function<void(bool)>;
+
+    struct ReadRequest {
+        std::string path;
+        ReadCallback callback;
+    };
+
+    struct WriteRequest {
+        std::string path;
+        std::string data;
+        WriteCallback callback;
+    };
+
+   public:
+    virtual ~DiskEngine() noexcept = default;
+
+    virtual void submit(std::vector<ReadRequest> reads) = 0;
+    virtual void submit(std::vector<WriteRequest> writes) = 0;
+
+    std::future<std::optional<std::string>> read(std::string path) {
+        auto promise = std::make_shared<std::promise<std::optional<std::string>>>();
+        auto future = promise->get_future();
+
+        std::vector<ReadRequest> reads;
+        reads.push_back({std::move(path), [promise](std::optional<std::string> data) {
+                             promise->set_value(std::move(data));
+                         }});
+        submit(std::move(reads));
+        return future;
+    }
+
+    std::future<bool> write(std::string path, std::string data) {
+        auto promise = std::make_shared<std::promise<bool>>();
+        auto future = promise->get_future();
+
+        std::vector<WriteRequest> writes;
+        writes.push_back({std::move(path), std::move(data), [promise](bool ok) {
+                              promise->set_value(ok);
+                          }});
+        submit(std::move(writes));
+        return future;
+    }
+};
+
+// Invokes the completion callback once every request of a batch has completed.
+class BatchCompletion {
+   public:
+    using Callback = std::function<void(bool)>;
+
+   public:
+    BatchCompletion(size_t count, Callback onComplete) :
+        m_remaining {count},
+        m_onComplete {std::move(onComplete)} {
+        if (count == 0) {
+            m_onComplete(true);
+        }
+    }
+
+    void complete(bool ok) noexcept {
+        if (not ok) {
+            m_failed = true;
+        }
+
+        if (m_remaining.fetch_sub(1) == 1) {
+            m_onComplete(not m_failed);
+        }
+    }
+
+   private:
+    std::atomic_size_t m_remaining;
+    std::atomic_bool m_failed {false};
+    Callback m_onComplete;
+};
+
+// Adapts a batch callback to a future, a failed batch throws from get().
+inline std::pair<BatchCompletion::Callback, std::future<void>> makeFutureCallback() {
+    auto promise = std::make_shared<std::promise<void>>();
+    auto future = promise->get_future();
+    auto callback = [promise] (bool ok) {
+        if (ok) {
+            promise->set_value();
+        } else {
+            promise->set_exception(std::make_exception_ptr(std::logic_error("Disk I/O error")));
+        }
+    };
+    return {std::move(callback), std::move(future)};
+}
+
+inline std::optional<std::string> readFile(std::string const& path) {
+    std::ifstream stream(path, std::ios::binary | std::ios::ate);
+    if (not stream.is_open()) {
+        return std::nullopt;
+    }
+
+    auto const size = static_cast<size_t>(stream.tellg());
+    std::string data(size, '\0');
+    stream.seekg(0);
+    if (not stream.read(data.data(), static_cast<std::streamsize>(size))) {
+        return std::nullopt;
+    }
+
+    return data;
+}
+
+inline bool writeFile(std::string const& path, std::string const& data) {
+    std::ofstream stream(path, std::ios::binary | std::ios::trunc);
+    if (not stream.is_open()) {
+        return false;
+    }
+
+    stream.write(data.data(), static_cast<std::streamsize>(data.size()));
+    return static_cast<bool>(stream.flush());
+}
+
+class ThreadPoolEngine final : public DiskEngine {
+   public:
+    explicit ThreadPoolEngine(size_t threads) :
+        m_pool {threads} {}
+
+    void submit(std::vector<ReadRequest> reads) override {
+        for (auto& request: reads) {
+            m_pool.post([request = std::move(request)] {
+                request.callback(readFile(request.path));
+            });
+        }
+    }
+
+    void submit(std::vector<WriteRequest> writes) override {
+        for (auto& request: writes) {
+            m_pool.post([request = std::move(request)] {
+                request.callback(writeFile(request.path, request.data));
+            });
+        }
+    }
+
+   private:
+    ThreadPool m_pool;
+};
+
+#if defined(BINARY_STORAGE_WITH_IO_URING)
+
+// io_uring engine driven through raw syscalls, so no liburing is required.
+// Every batch is pushed into the submission ring with a single io_uring_enter,
+// a dedicated thread reaps completions and resubmits short transfers. Once the
+// kernel refuses a submission the ring is no longer used and the operations it
+// has not taken, as well as all later ones, fail through their callbacks.
+class IoUringEngine final : public DiskEngine {
+   public:
+    explicit IoUringEngine(unsigned entries) {
+        io_uring_params params {};
+        m_ring = static_cast<int>(syscall(__NR_io_uring_setup, entries, &params));
+        if (m_ring < 0) {
+            throw std::system_error(errno, std::system_category(), "io_uring_setup");
+        }
+
+        try {
+            mapRings(params);
+        } catch (...) {
+            unmapRings();
+            close(m_ring);
+            throw;
+        }
+
+        m_maxInFlight = params.cq_entries;
+        m_timedWait = params.features & IORING_FEAT_EXT_ARG;
+        m_completionThread = std::thread([this] { completionLoop(); });
+    }
+
+    ~IoUringEngine() noexcept override {
+        std::vector<std::unique_ptr<Operation>> failed;
+        {
+            std::unique_lock lock(m_mutex);
+            m_stoped = true;
+            pushWakeup(failed);
+        }
+        finish(failed);
+        m_completionThread.join();
+
+        unmapRings();
+        close(m_ring);
+    }
+
+    void submit(std::vector<ReadRequest> reads) override {
+        std::vector<ReadRequest> failed;
+        std::vector<std::unique_ptr<Operation>> unsubmitted;
+        {
+            std::unique_lock lock(m_mutex);
+            for (auto& request: reads) {
+                auto const fd = open(request.path.c_str(), O_RDONLY | O_CLOEXEC);
+                struct stat info {};
+                if (fd < 0 or fstat(fd, &info) != 0) {
+                    if (fd >= 0) {
+                        close(fd);
+                    }
+                    failed.push_back(std::move(request));
+                    continue;
+                }
+
+                auto operation = std::make_unique<Operation>();
+                operation->read = true;
+                operation->fd = fd;
+                operation->buffer.resize(static_cast<size_t>(info.st_size));
+                operation->onRead = std::move(request.callback);
+                m_pending.push_back(std::move(operation));
+            }
+            flushPending(unsubmitted);
+        }
+
+        for (auto& request: failed) {
+            request.callback(std::nullopt);
+        }
+        finish(unsubmitted);
+    }
+
+    void submit(std::vector<WriteRequest> writes) override {
+        std::vector<WriteRequest> failed;
+        std::vector<std::unique_ptr<Operation>> unsubmitted;
+        {
+            std::unique_lock lock(m_mutex);
+            for (auto& request: writes) {
+                auto const fd = open(request.path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+                if (fd < 0) {
+                    failed.push_back(std::move(request));
+                    continue;
+                }
+
+                auto operation = std::make_unique<Operation>();
+                operation->fd = fd;
+                operation->buffer = std::move(request.data);
+                operation->onWrite = std::move(request.callback);
+                m_pending.push_back(std::move(operation));
+            }
+            flushPending(unsubmitted);
+        }
+
+        for (auto& request: failed) {
+            request.callback(false);
+        }
+        finish(unsubmitted);
+    }
+
+   private:
+    struct Operation {
+        bool read {false};
+        int fd {-1};
+        std::string buffer;
+        size_t done {0};
+        iovec vector {};
+        ReadCallback onRead;
+        WriteCallback onWrite;
+    };
+
+   private:
+    int m_ring {-1};
+    void* m_sqRing {nullptr};
+    void* m_cqRing {nullptr};
+    size_t m_sqRingSize {0};
+    size_t m_cqRingSize {0};
+    io_uring_sqe* m_sqes {nullptr};
+    size_t m_sqesSize {0};
+
+    unsigned* m_sqHead {nullptr};
+    unsigned* m_sqTail {nullptr};
+    unsigned* m_sqMask {nullptr};
+    unsigned* m_sqArray {nullptr};
+    unsigned m_sqEntries {0};
+    unsigned* m_cqHead {nullptr};
+    unsigned* m_cqTail {nullptr};
+    unsigned* m_cqMask {nullptr};
+    io_uring_cqe* m_cqes {nullptr};
+
+    std::mutex m_mutex;
+    std::deque<std::unique_ptr<Operation>> m_pending;
+    size_t m_inFlight {0};
+    size_t m_maxInFlight {0};
+    bool m_timedWait {false};
+    bool m_failed {false};
+    bool m_stoped {false};
+    std::thread m_completionThread;
+
+   private:
+    void mapRings(io_uring_params const& params) {
+        m_sqEntries = params.sq_entries;
+        m_sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+        m_cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+
+        bool const singleMap = params.features & IORING_FEAT_SINGLE_MMAP;
+        if (singleMap) {
+            m_sqRingSize = m_cqRingSize = std::max(m_sqRingSize, m_cqRingSize);
+        }
+
+        m_sqRing = mapRegion(m_sqRingSize, IORING_OFF_SQ_RING);
+        m_cqRing = singleMap ? m_sqRing : mapRegion(m_cqRingSize, IORING_OFF_CQ_RING);
+        m_sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+        m_sqes = static_cast<io_uring_sqe*>(mapRegion(m_sqesSize, IORING_OFF_SQES));
+
+        auto const sq = static_cast<char*>(m_sqRing);
+        m_sqHead = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+        m_sqTail = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+        m_sqMask = reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+        m_sqArray = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+
+        auto const cq = static_cast<char*>(m_cqRing);
+        m_cqHead = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+        m_cqTail = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+        m_cqMask = reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+        m_cqes = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+    }
+
+    void* mapRegion(size_t size, off_t offset) {
+        auto const region = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_ring, offset);
+        if (region == MAP_FAILED) {
+            throw std::system_error(errno, std::system_category(), "io_uring mmap");
+        }
+        return region;
+    }
+
+    void unmapRings() noexcept {
+        if (m_sqes != nullptr) {
+            munmap(m_sqes, m_sqesSize);
+        }
+        if (m_cqRing != nullptr and m_cqRing != m_sqRing) {
+            munmap(m_cqRing, m_cqRingSize);
+        }
+        if (m_sqRing != nullptr) {
+            munmap(m_sqRing, m_sqRingSize);
+        }
+        m_sqes = nullptr;
+        m_sqRing = m_cqRing = nullptr;
+    }
+
+    io_uring_sqe* nextSqe() noexcept {
+        auto const tail = *m_sqTail;
+        auto const head = __atomic_load_n(m_sqHead, __ATOMIC_ACQUIRE);
+        if (tail - head >= m_sqEntries) {
+            return nullptr;
+        }
+
+        auto const index = tail & *m_sqMask;
+        auto sqe = &m_sqes[index];
+        std::memset(sqe, 0, sizeof(io_uring_sqe));
+        m_sqArray[index] = index;
+        __atomic_store_n(m_sqTail, tail + 1, __ATOMIC_RELEASE);
+        return sqe;
+    }
+
+    // Submits all toSubmit entries. Returns false on an error other than an
+    // interruption, a temporary lack of resources or an expired wait, or when
+    // the kernel stops taking entries.
+    bool enter(unsigned toSubmit, unsigned minComplete, unsigned flags, void const* arg = nullptr, size_t argSize = 0) noexcept {
+        while (true) {
+            auto const result = syscall(__NR_io_uring_enter, m_ring, toSubmit, minComplete, flags, arg, argSize);
+            if (result < 0) {
+                if (errno == ETIME) {
+                    return true;
+                }
+                if (errno != EINTR and errno != EAGAIN and errno != EBUSY) {
+                    return false;
+                }
+                continue;
+            }
+
+            if (toSubmit == 0) {
+                return true;
+            }
+            if (result == 0) {
+                return false;
+            }
+            toSubmit -= std::min(toSubmit, static_cast<unsigned>(result));
+            if (toSubmit == 0) {
+                return true;
+            }
+        }
+    }
+
+    // Waits for a completion, for a bounded time when the kernel allows it so
+    // that the completion thread notices a failed ring or a stop by itself.
+    bool waitCompletions() noexcept {
+        if (not m_timedWait) {
+            return enter(0, 1, IORING_ENTER_GETEVENTS);
+        }
+
+        __kernel_timespec timeout {0, 100 * 1000 * 1000};
+        io_uring_getevents_arg arg {};
+        arg.ts = reinterpret_cast<uint64_t>(&timeout);
+        return enter(0, 1, IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG, &arg, sizeof(arg));
+    }
+
+    // Must be called with m_mutex held. After a failed submission the ring is
+    // not used for new operations: entries the kernel has not taken are taken
+    // back and, with everything still pending, moved to failed. Operations the
+    // kernel has taken complete as usual.
+    void failRing(std::vector<std::unique_ptr<Operation>>& failed) noexcept {
+        m_failed = true;
+        auto const first = failed.size();
+        auto const head = __atomic_load_n(m_sqHead, __ATOMIC_ACQUIRE);
+        for (auto tail = *m_sqTail; tail != head; --tail) {
+            auto const operation = reinterpret_cast<Operation*>(m_sqes[m_sqArray[(tail - 1) & *m_sqMask]].user_data);
+            --m_inFlight;
+            if (operation != nullptr) {
+                failed.emplace_back(operation);
+            }
+        }
+        __atomic_store_n(m_sqTail, head, __ATOMIC_RELEASE);
+
+        for (auto& operation: m_pending) {
+            failed.push_back(std::move(operation));
+        }
+        m_pending.clear();
+
+        for (auto i = first; i < failed.size(); ++i) {
+            failed[i]->buffer.clear();
+            failed[i]->done = std::string::npos;
+        }
+    }
+
+    // Must be called with m_mutex held.
+    void pushWakeup(std::vector<std::unique_ptr<Operation>>& failed) noexcept {
+        auto sqe = nextSqe();
+        if (sqe == nullptr) {
+            return;
+        }
+
+        sqe->opcode = IORING_OP_NOP;
+        sqe->user_data = 0;
+        ++m_inFlight;
+        if (not enter(1, 0, 0)) {
+            failRing(failed);
+        }
+    }
+
+    // Must be called with m_mutex held, operations that can't be submitted
+    // are moved to failed.
+    void flushPending(std::vector<std::unique_ptr<Operation>>& failed) noexcept {
+        if (m_failed) {
+            failRing(failed);
+            return;
+        }
+
+        unsigned queued = 0;
+        while (not m_pending.empty() and m_inFlight < m_maxInFlight) {
+            auto sqe = nextSqe();
+            if (sqe == nullptr) {
+                break;
+            }
+
+            auto operation = m_pending.front().release();
+            m_pending.pop_front();
+            prepare(sqe, *operation);
+            ++m_inFlight;
+            ++queued;
+        }
+
+        if (queued != 0 and not enter(queued, 0, 0)) {
+            failRing(failed);
+        }
+    }
+
+    static void prepare(io_uring_sqe* sqe, Operation& operation) noexcept {
+        operation.vector.iov_base = operation.buffer.data() + operation.done;
+        operation.vector.iov_len = operation.buffer.size() - operation.done;
+
+        sqe->opcode = operation.read ? IORING_OP_READV : IORING_OP_WRITEV;
+        sqe->fd = operation.fd;
+        sqe->off = operation.done;
+        sqe->addr = reinterpret_cast<uint64_t>(&operation.vector);
+        sqe->len = 1;
+        sqe->user_data = reinterpret_cast<uint64_t>(&operation);
+    }
+
+    // Polls the completion queue once waiting in the kernel has failed, the
+    // operations already taken by the kernel still complete there.
+    void completionLoop() noexcept {
+        bool polling = false;
+        while (true) {
+            if (polling or not waitCompletions()) {
+                polling = true;
+                std::this_thread::sleep_for(std::chrono::milliseconds {1});
+            }
+
+            std::vector<std::pair<Operation*, int>> completed;
+            auto head = *m_cqHead;
+            auto const tail = __atomic_load_n(m_cqTail, __ATOMIC_ACQUIRE);
+            for (; head != tail; ++head) {
+                auto const& cqe = m_cqes[head & *m_cqMask];
+                completed.emplace_back(reinterpret_cast<Operation*>(cqe.user_data), cqe.res);
+            }
+            __atomic_store_n(m_cqHead, head, __ATOMIC_RELEASE);
+
+            std::vector<std::unique_ptr<Operation>> finished;
+            {
+                std::unique_lock lock(m_mutex);
+                for (auto const& [operation, result]: completed) {
+                    --m_inFlight;
+                    if (operation == nullptr) {
+                        continue;
+                    }
+
+                    if (result == -EINTR or result == -EAGAIN or (result > 0 and advance(*operation, result))) {
+                        m_pending.emplace_front(operation);
+                        continue;
+                    }
+
+                    if (result < 0 or (not operation->read and operation->done < operation->buffer.size())) {
+                        operation->buffer.clear();
+                        operation->done = std::string::npos;
+                    }
+                    finished.emplace_back(operation);
+                }
+                flushPending(finished);
+
+                if (m_stoped and m_inFlight == 0 and m_pending.empty()) {
+                    lock.unlock();
+                    finish(finished);
+                    return;
+                }
+            }
+
+            finish(finished);
+        }
+    }
+
+    // Returns true when the transfer is still incomplete and must be resubmitted.
+    static bool advance(Operation& operation, int transferred) noexcept {
+        operation.done += static_cast<size_t>(transferred);
+        return operation.done < operation.buffer.size();
+    }
+
+    static void finish(std::vector<std::unique_ptr<Operation>>& operations) noexcept {
+        for (auto& operation: operations) {
+            close(operation->fd);
+            bool const failed = operation->done == std::string::npos;
+
+            if (operation->read) {
+                if (failed) {
+                    operation->onRead(std::nullopt);
+                } else {
+                    operation->buffer.resize(operation->done);
+                    operation->onRead(std::move(operation->buffer));
+                }
+            } else {
+                operation->onWrite(not failed);
+            }
+        }
+    }
+};
+
+#endif
+
+inline std::unique_ptr<DiskEngine> makeDiskEngine(DiskEngineKind kind, size_t threads, unsigned queueDepth) {
+#if defined(BINARY_STORAGE_WITH_IO_URING)
+    if (kind != DiskEngineKind::ThreadPool) {
+        try {
+            return std::make_unique<IoUringEngine>(queueDepth);
+        } catch (std::system_error const&) {
+            if (kind == DiskEngineKind::IoUring) {
+                throw;
+            }
+        }
+    }
+#else
+    (void)queueDepth;
+    if (kind == DiskEngineKind::IoUring) {
+        throw std::logic_error("io_uring disk engine is not available in this build");
+    }
+#endif
+
+    return std::make_unique<ThreadPoolEngine>(threads);
+}
+
+} // namespace binary_storage::storage
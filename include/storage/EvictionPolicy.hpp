@@ -0,0 +1,262 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <numeric>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+namespace binary_storage::storage {
+
+// Decides which resident values fitSize moves out of memory.
+class EvictionPolicy {
+   public:
+    struct Candidate {
+        std::string const* key;
+        std::chrono::system_clock::time_point lastAccess;
+        size_t size;
+    };
+
+    // What may stay resident. Sizes are serialized sizes, the byte limit only
+    // applies when bytes is not zero.
+    struct Budget {
+        size_t count;
+        size_t bytes;
+    };
+
+   public:
+    virtual ~EvictionPolicy() noexcept = default;
+
+    // Called for every store and load, possibly concurrently.
+    virtual void recordAccess(std::string const& key) noexcept = 0;
+
+    // Returns indexes of the candidates to evict so that the rest fits the budget.
+    virtual std::vector<size_t> selectVictims(std::vector<Candidate> const& resident, Budget budget) = 0;
+
+   protected:
+    // Evicts candidates in the given order until the remaining ones fit the budget.
+    static std::vector<size_t> takeUntilFits(std::vector<Candidate> const& resident,
+                                             std::vector<size_t> const& order,
+                                             Budget budget) {
+        size_t bytes = 0;
+        for (auto const& candidate: resident) {
+            bytes += candidate.size;
+        }
+
+        std::vector<size_t> victims;
+        auto count = resident.size();
+        for (auto const index: order) {
+            if (count <= budget.count and (budget.bytes == 0 or bytes <= budget.bytes)) {
+                break;
+            }
+
+            victims.push_back(index);
+            bytes -= resident[index].size;
+            --count;
+        }
+        return victims;
+    }
+};
+
+// Evicts the entries stored or reloaded the longest time ago.
+class RecencyPolicy final : public EvictionPolicy {
+   public:
+    void recordAccess(std::string const&) noexcept override {}
+
+    std::vector<size_t> selectVictims(std::vector<Candidate> const& resident, Budget budget) override {
+        std::vector<size_t> order(resident.size());
+        std::iota(order.begin(), order.end(), 0);
+        std::sort(order.begin(), order.end(), [&] (size_t lhs, size_t rhs) {
+            return resident[lhs].lastAccess < resident[rhs].lastAccess;
+        });
+        return takeUntilFits(resident, order, budget);
+    }
+};
+
+// Count-min sketch of 4-bit saturating counters, halved every `sampleSize`
+// increments so that the estimate follows recent popularity.
+class FrequencySketch {
+   public:
+    explicit FrequencySketch(size_t expectedEntries) {
+        size_t width = 64;
+        while (width < expectedEntries) {
+            width <<= 1;
+        }
+
+        m_mask = width - 1;
+        m_table = std::make_unique<std::atomic<uint64_t>[]>(width);
+        for (size_t i = 0; i < width; ++i) {
+            m_table[i].store(0, std::memory_order_relaxed);
+        }
+        m_sampleSize = 10 * width;
+    }
+
+    void increment(std::string const& key) noexcept {
+        auto const hash = std::hash<std::string> {}(key);
+        bool added = false;
+        for (unsigned i = 0; i < depth; ++i) {
+            added |= incrementAt(index(hash, i), counterOffset(hash, i));
+        }
+
+        if (added and m_additions.fetch_add(1, std::memory_order_relaxed) + 1 == m_sampleSize) {
+            reset();
+        }
+    }
+
+    unsigned estimate(std::string const& key) const noexcept {
+        auto const hash = std::hash<std::string> {}(key);
+        unsigned frequency = maxCounter;
+        for (unsigned i = 0; i < depth; ++i) {
+            auto const word = m_table[index(hash, i)].load(std::memory_order_relaxed);
+            frequency = std::min(frequency, static_cast<unsigned>((word >> counterOffset(hash, i)) & maxCounter));
+        }
+        return frequency;
+    }
+
+   private:
+    static constexpr unsigned depth {4};
+    static constexpr uint64_t maxCounter {15};
+
+    std::unique_ptr<std::atomic<uint64_t>[]> m_table;
+    size_t m_mask {0};
+    size_t m_sampleSize {0};
+    std::atomic_size_t m_additions {0};
+    std::mutex m_resetMutex;
+
+   private:
+    static uint64_t mix(uint64_t hash, unsigned row) noexcept {
+        hash += 0x9e3779b97f4a7c15ULL * (row + 1);
+        hash = (hash ^ (hash >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        hash = (hash ^ (hash >> 27)) * 0x94d049bb133111ebULL;
+        return hash ^ (hash >> 31);
+    }
+
+    size_t index(uint64_t hash, unsigned row) const noexcept {
+        return mix(hash, row) & m_mask;
+    }
+
+    // Every 64-bit word packs sixteen counters.
+    static unsigned counterOffset(uint64_t hash, unsigned row) noexcept {
+        return static_cast<unsigned>((mix(hash, row) >> 58) & 15) * 4;
+    }
+
+    bool incrementAt(size_t index, unsigned offset) noexcept {
+        auto& word = m_table[index];
+        auto current = word.load(std::memory_order_relaxed);
+        while (((current >> offset) & maxCounter) != maxCounter) {
+            if (word.compare_exchange_weak(current, current + (uint64_t {1} << offset), std::memory_order_relaxed)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void reset() noexcept {
+        std::unique_lock lock(m_resetMutex);
+        for (size_t i = 0; i <= m_mask; ++i) {
+            auto current = m_table[i].load(std::memory_order_relaxed);
+            while (not m_table[i].compare_exchange_weak(
+                current, (current >> 1) & 0x7777777777777777ULL, std::memory_order_relaxed)) {
+            }
+        }
+        m_additions.store(m_sampleSize / 2, std::memory_order_relaxed);
+    }
+};
+
+// W-TinyLFU: the most recently stored or reloaded entries form a small window
+// that is always kept. Entries that left the window since the last selection
+// are candidates for the main region, each is compared with the least
+// recently used admitted entry and whichever has the lower estimated access
+// frequency is evicted, the candidate on a tie, so one-off scans do not push
+// out the hot set. Frequencies are per serialized byte, which favours many
+// small hot values over a single huge one. The admitted set is kept between
+// selections, so a policy should serve a single storage.
+class TinyLfuPolicy final : public EvictionPolicy {
+   public:
+    explicit TinyLfuPolicy(size_t expectedEntries, double windowRatio = 0.01) :
+        m_sketch {expectedEntries},
+        m_windowRatio {windowRatio} {}
+
+    void recordAccess(std::string const& key) noexcept override {
+        m_sketch.increment(key);
+    }
+
+    std::vector<size_t> selectVictims(std::vector<Candidate> const& resident, Budget budget) override {
+        std::vector<size_t> order(resident.size());
+        std::iota(order.begin(), order.end(), 0);
+
+        auto const window = static_cast<size_t>(resident.size() * m_windowRatio);
+        std::partial_sort(order.begin(), order.begin() + window, order.end(), [&] (size_t lhs, size_t rhs) {
+            return resident[lhs].lastAccess > resident[rhs].lastAccess;
+        });
+
+        std::vector<double> scores(resident.size());
+        for (size_t i = 0; i < resident.size(); ++i) {
+            scores[i] = (m_sketch.estimate(*resident[i].key) + 1.0)
+                / static_cast<double>(std::max<size_t>(resident[i].size, 1));
+        }
+
+        std::unique_lock lock(m_admittedMutex);
+        std::vector<size_t> candidates;
+        std::vector<size_t> admitted;
+        for (auto it = order.begin() + window; it != order.end(); ++it) {
+            (m_admitted.count(*resident[*it].key) != 0 ? admitted : candidates).push_back(*it);
+        }
+
+        auto const older = [&] (size_t lhs, size_t rhs) {
+            return resident[lhs].lastAccess < resident[rhs].lastAccess;
+        };
+        std::sort(admitted.begin(), admitted.end(), older);
+        std::sort(candidates.begin(), candidates.end(), [&] (size_t lhs, size_t rhs) {
+            return scores[lhs] != scores[rhs] ? scores[lhs] < scores[rhs] : older(lhs, rhs);
+        });
+
+        // The loser of every comparison is evicted first and the winner meets
+        // the next entry of the other side.
+        std::vector<size_t> ranked;
+        ranked.reserve(candidates.size() + admitted.size());
+        auto candidate = candidates.begin();
+        auto victim = admitted.begin();
+        while (candidate != candidates.end() or victim != admitted.end()) {
+            if (victim == admitted.end() or (candidate != candidates.end() and scores[*candidate] <= scores[*victim])) {
+                ranked.push_back(*candidate++);
+            } else {
+                ranked.push_back(*victim++);
+            }
+        }
+        auto victims = takeUntilFits(resident, ranked, budget);
+
+        std::vector<bool> evicted(resident.size(), false);
+        for (auto const index: victims) {
+            evicted[index] = true;
+        }
+        std::unordered_set<std::string> survivors;
+        for (size_t i = 0; i < order.size(); ++i) {
+            auto const& key = *resident[order[i]].key;
+            if (not evicted[order[i]] and (i >= window or m_admitted.count(key) != 0)) {
+                survivors.insert(key);
+            }
+        }
+        m_admitted = std::move(survivors);
+        return victims;
+    }
+
+    unsigned frequency(std::string const& key) const noexcept {
+        return m_sketch.estimate(key);
+    }
+
+   private:
+    FrequencySketch m_sketch;
+    double m_windowRatio;
+    // Keys that made it past the window and stayed resident.
+    std::unordered_set<std::string> m_admitted;
+    std::mutex m_admittedMutex;
+};
+
+} // namespace binary_storage::storage
@@ -0,0 +1,184 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <future>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "ThreadPool.hpp"
+
+namespace binary_storage::storage {
+
+// Where the per-file backend puts the file of a key. Keys are encoded into
+// file names that are valid on every file system: letters, digits, '-' and
+// '_' are kept, every other byte, and a '.' that would start the name, is
+// written as '%' followed by two hex digits. With fan-out levels the file goes
+// into nested directories named after bytes of a stable hash of the key, e.g.
+// "3f/a0/<encoded key>.bin" for two levels, so no directory grows too large.
+
+// Longest file name common file systems accept, NAME_MAX on Linux.
+inline constexpr size_t maxFileName {255};
+
+// Escapes can make the name three times as long as the key. Throws
+// std::logic_error when the name followed by reserve more bytes would be
+// longer than maxFileName, a shortened name could not be decoded back.
+inline std::string encodeKey(std::string_view key, size_t reserve = 0) {
+    constexpr char digits[] {"0123456789ABCDEF"};
+    std::string result;
+    result.reserve(key.size());
+    for (size_t i = 0; i < key.size(); ++i) {
+        auto const symbol = static_cast<unsigned char>(key[i]);
+        auto const plain = (symbol >= 'a' and symbol <= 'z') or (symbol >= 'A' and symbol <= 'Z')
+                           or (symbol >= '0' and symbol <= '9') or symbol == '-' or symbol == '_'
+                           or (symbol == '.' and i != 0);
+        if (plain) {
+            result.push_back(static_cast<char>(symbol));
+        } else {
+            result.push_back('%');
+            result.push_back(digits[symbol >> 4]);
+            result.push_back(digits[symbol & 0xF]);
+        }
+    }
+
+    if (result.size() + reserve > maxFileName) {
+        throw std::logic_error("Key is too long for a file name: " + std::string(key));
+    }
+    return result;
+}
+
+// Returns std::nullopt for a malformed escape.
+inline std::optional<std::string> decodeKey(std::string_view name) {
+    auto const digit = [] (char symbol) -> int {
+        if (symbol >= '0' and symbol <= '9') {
+            return symbol - '0';
+        }
+        if (symbol >= 'A' and symbol <= 'F') {
+            return symbol - 'A' + 10;
+        }
+        return -1;
+    };
+
+    std::string result;
+    result.reserve(name.size());
+    for (size_t i = 0; i < name.size(); ++i) {
+        if (name[i] != '%') {
+            result.push_back(name[i]);
+            continue;
+        }
+
+        if (i + 2 >= name.size()) {
+            return std::nullopt;
+        }
+        auto const high = digit(name[i + 1]);
+        auto const low = digit(name[i + 2]);
+        if (high < 0 or low < 0) {
+            return std::nullopt;
+        }
+        result.push_back(static_cast<char>(high << 4 | low));
+        i += 2;
+    }
+    return result;
+}
+
+// 64-bit FNV-1a, stable across runs and platforms unlike std::hash.
+inline uint64_t keyHash(std::string_view key) noexcept {
+    uint64_t hash = 0xcbf29ce484222325ull;
+    for (auto const symbol: key) {
+        hash ^= static_cast<unsigned char>(symbol);
+        hash *= 0x100000001b3ull;
+    }
+    return hash;
+}
+
+// Index of the innermost fan-out directory of the key, in [0, 256^levels).
+inline size_t fanOutBucket(std::string_view key, size_t levels) noexcept {
+    return levels == 0 ? 0 : static_cast<size_t>(keyHash(key) >> (64 - 8 * levels));
+}
+
+// Relative directory of the key, empty or ending with a separator.
+inline std::string fanOutDirectory(std::string_view key, size_t levels) {
+    constexpr char digits[] {"0123456789abcdef"};
+    auto const bucket = fanOutBucket(key, levels);
+    std::string result;
+    for (size_t level = 0; level < levels; ++level) {
+        auto const byte = (bucket >> (8 * (levels - level - 1))) & 0xFF;
+        result.push_back(digits[byte >> 4]);
+        result.push_back(digits[byte & 0xF]);
+        result.push_back(std::filesystem::path::preferred_separator);
+    }
+    return result;
+}
+
+struct StoredFile {
+    std::string key;
+    std::string location;
+    uint64_t size;
+    std::filesystem::file_time_type lastWrite;
+};
+
+// Lists the value files under the directory, which ends with a separator,
+// walking the fan-out directories in parallel. Files whose name is not a
+// valid encoded key are skipped.
+inline std::vector<StoredFile> scanFiles(std::string const& directory,
+                                         std::string const& extension,
+                                         size_t levels,
+                                         bool encoded,
+                                         size_t threads) {
+    namespace fs = std::filesystem;
+    auto const scan = [&] (fs::path const& root, size_t depth) {
+        std::vector<StoredFile> files;
+        std::vector<std::pair<fs::path, size_t>> pending {{root, depth}};
+        while (not pending.empty()) {
+            auto const [path, level] = pending.back();
+            pending.pop_back();
+            for (auto const& entry: fs::directory_iterator(path)) {
+                if (level < levels) {
+                    if (entry.is_directory() and entry.path().filename().string().size() == 2) {
+                        pending.emplace_back(entry.path(), level + 1);
+                    }
+                    continue;
+                }
+
+                if (not entry.is_regular_file() or entry.path().extension() != extension) {
+                    continue;
+                }
+
+                auto const stem = entry.path().stem().string();
+                auto key = encoded ? decodeKey(stem) : std::optional<std::string> {stem};
+                if (key.has_value()) {
+                    files.push_back({std::move(*key),
+                                     entry.path().string().substr(directory.size()),
+                                     entry.file_size(),
+                                     entry.last_write_time()});
+                }
+            }
+        }
+        return files;
+    };
+
+    if (levels == 0 or threads <= 1) {
+        return scan(directory, 0);
+    }
+
+    ThreadPool pool(threads);
+    std::vector<std::future<std::vector<StoredFile>>> parts;
+    for (auto const& entry: fs::directory_iterator(directory)) {
+        if (entry.is_directory() and entry.path().filename().string().size() == 2) {
+            parts.push_back(pool.submit([&scan, path = entry.path()] { return scan(path, 1); }));
+        }
+    }
+
+    std::vector<StoredFile> files;
+    for (auto& part: parts) {
+        auto items = part.get();
+        files.insert(files.end(), std::make_move_iterator(items.begin()), std::make_move_iterator(items.end()));
+    }
+    return files;
+}
+
+} // namespace binary_storage::storage
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string_view>
+
+#include "FileLayout.hpp"
+
+namespace binary_storage::storage {
+
+// Bloom filter over the keys of a storage. Keys can only be added, lookups
+// may run concurrently with adds and never report an added key as missing.
+class KeyFilter {
+   public:
+    KeyFilter(size_t keys, size_t bitsPerKey) :
+        m_capacity {std::max<size_t>(keys, 64)},
+        m_mask {wordsCount(m_capacity * bitsPerKey) * 64 - 1},
+        m_hashes {hashesCount(bitsPerKey)},
+        m_words(new std::atomic<uint64_t>[(m_mask + 1) / 64]) {
+        for (size_t i = 0; i < (m_mask + 1) / 64; ++i) {
+            m_words[i].store(0, std::memory_order_relaxed);
+        }
+    }
+
+    KeyFilter(KeyFilter const&) = delete;
+    KeyFilter(KeyFilter&&) noexcept = delete;
+    KeyFilter& operator=(KeyFilter const&) = delete;
+    KeyFilter& operator=(KeyFilter&&) noexcept = delete;
+
+   public:
+    void add(std::string_view key) noexcept {
+        forEachBit(key, [this] (size_t bit) {
+            m_words[bit / 64].fetch_or(uint64_t {1} << (bit % 64), std::memory_order_relaxed);
+            return true;
+        });
+    }
+
+    // False only for keys that were never added.
+    bool mayContain(std::string_view key) const noexcept {
+        return forEachBit(key, [this] (size_t bit) {
+            return (m_words[bit / 64].load(std::memory_order_relaxed) & (uint64_t {1} << (bit % 64))) != 0;
+        });
+    }
+
+    // Number of keys the filter was sized for.
+    size_t capacity() const noexcept {
+        return m_capacity;
+    }
+
+   private:
+    size_t m_capacity;
+    size_t m_mask;
+    size_t m_hashes;
+    std::unique_ptr<std::atomic<uint64_t>[]> m_words;
+
+   private:
+    static size_t wordsCount(size_t bits) noexcept {
+        size_t words = 1;
+        while (words * 64 < bits) {
+            words <<= 1;
+        }
+        return words;
+    }
+
+    // About bitsPerKey * ln 2 hashes minimize false positives.
+    static size_t hashesCount(size_t bitsPerKey) noexcept {
+        return std::clamp<size_t>(bitsPerKey * 7 / 10, 1, 16);
+    }
+
+    // Double hashing, stops once check returns false.
+    template<class F>
+    bool forEachBit(std::string_view key, F&& check) const noexcept {
+        auto const first = keyHash(key);
+        auto const second = std::hash<std::string_view> {}(key) | 1;
+        for (size_t i = 0; i < m_hashes; ++i) {
+            if (not check(static_cast<size_t>(first + i * second) & m_mask)) {
+                return false;
+            }
+        }
+        return true;
+    }
+};
+
+} // namespace binary_storage::storage
@@ -0,0 +1,393 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#if __has_include(<sys/mman.h>)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define BINARY_STORAGE_MANIFEST_MMAP 1
+#endif
+
+#include "serde/traits.hpp"
+#include "serde/serde.hpp"
+
+namespace binary_storage::storage {
+
+// Persistent index of the values written to disk: a checkpoint file with
+// records sorted by key that is memory mapped and binary searched, plus an
+// append-only journal of the changes since that checkpoint. A damaged
+// checkpoint is ignored, leaving only the journal, and reported by rejected()
+// so the owner can rebuild it. Not thread safe, Storage calls it under its
+// exclusive lock.
+class Manifest {
+   public:
+    struct Entry {
+        std::string key;
+        std::string location;
+        uint64_t size {0};
+        std::chrono::system_clock::time_point lastAccess;
+    };
+
+   public:
+    explicit Manifest(std::string directory) :
+        m_checkpointPath {directory + checkpointName},
+        m_journalPath {directory + journalName} {
+        m_rejected = not mapCheckpoint();
+        replayJournal();
+        m_journal.open(m_journalPath, std::ios::binary | std::ios::app);
+        if (not m_journal.is_open()) {
+            throw std::logic_error("Can't open manifest journal: " + m_journalPath);
+        }
+    }
+
+    Manifest(Manifest const&) = delete;
+    Manifest(Manifest&&) noexcept = delete;
+    Manifest& operator=(Manifest const&) = delete;
+    Manifest& operator=(Manifest&&) noexcept = delete;
+
+    ~Manifest() noexcept {
+        unmapCheckpoint();
+    }
+
+   public:
+    static bool exists(std::string const& directory) {
+        return std::filesystem::exists(directory + checkpointName) or std::filesystem::exists(directory + journalName);
+    }
+
+    std::optional<Entry> find(std::string const& key) const {
+        auto const change = m_changes.find(key);
+        if (change != m_changes.end()) {
+            return change->second;
+        }
+
+        auto const record = findRecord(key);
+        if (record == nullptr) {
+            return std::nullopt;
+        }
+        return makeEntry(*record);
+    }
+
+    void put(Entry entry) {
+        writeJournal(Put, entry);
+        auto key = entry.key;
+        m_changes.insert_or_assign(std::move(key), std::move(entry));
+    }
+
+    void erase(std::string const& key) {
+        if (not find(key).has_value()) {
+            return;
+        }
+
+        writeJournal(Erase, Entry {key, {}, 0, {}});
+        m_changes.insert_or_assign(key, std::nullopt);
+    }
+
+    // Visits every live entry in key order.
+    template<class F>
+    void forEach(F&& function) const {
+        auto change = m_changes.begin();
+        for (size_t i = 0; i < m_count; ++i) {
+            auto const& record = records()[i];
+            auto const key = text(record.keyOffset, record.keyLength);
+
+            for (; change != m_changes.end() and change->first < key; ++change) {
+                if (change->second.has_value()) {
+                    function(*change->second);
+                }
+            }
+
+            if (change != m_changes.end() and change->first == key) {
+                if (change->second.has_value()) {
+                    function(*change->second);
+                }
+                ++change;
+                continue;
+            }
+
+            function(makeEntry(record));
+        }
+
+        for (; change != m_changes.end(); ++change) {
+            if (change->second.has_value()) {
+                function(*change->second);
+            }
+        }
+    }
+
+    size_t count() const noexcept {
+        auto result = m_count;
+        for (auto const& [key, entry]: m_changes) {
+            auto const checkpointed = findRecord(key) != nullptr;
+            if (entry.has_value() and not checkpointed) {
+                ++result;
+            } else if (not entry.has_value() and checkpointed) {
+                --result;
+            }
+        }
+        return result;
+    }
+
+    size_t journalSize() const noexcept {
+        return m_changes.size();
+    }
+
+    // Whether the checkpoint was found damaged when the manifest was opened.
+    bool rejected() const noexcept {
+        return m_rejected;
+    }
+
+    // Folds the journal into a new checkpoint and starts an empty journal.
+    void checkpoint() {
+        std::vector<Entry> entries;
+        forEach([&] (Entry const& entry) { entries.push_back(entry); });
+        writeCheckpoint(entries);
+    }
+
+    // Replaces the whole manifest with the given entries.
+    void rebuild(std::vector<Entry> entries) {
+        std::sort(entries.begin(), entries.end(), [] (Entry const& lhs, Entry const& rhs) {
+            return lhs.key < rhs.key;
+        });
+        writeCheckpoint(entries);
+    }
+
+   private:
+    static constexpr char const* checkpointName {"manifest.idx"};
+    static constexpr char const* journalName {"manifest.log"};
+    static constexpr uint32_t magic {0x464d5342};
+    static constexpr uint32_t version {1};
+
+    enum Operation : uint8_t { Put = 1, Erase = 2 };
+
+    struct Header {
+        uint32_t magic;
+        uint32_t version;
+        uint64_t count;
+    };
+
+    struct Record {
+        uint64_t keyOffset;
+        uint64_t locationOffset;
+        uint32_t keyLength;
+        uint32_t locationLength;
+        uint64_t size;
+        int64_t lastAccess;
+    };
+
+    std::string m_checkpointPath;
+    std::string m_journalPath;
+    char const* m_data {nullptr};
+    size_t m_dataSize {0};
+    size_t m_count {0};
+    bool m_rejected {false};
+    std::string m_buffer;
+    std::map<std::string, std::optional<Entry>, std::less<>> m_changes;
+    std::ofstream m_journal;
+
+   private:
+    Record const* records() const noexcept {
+        return reinterpret_cast<Record const*>(m_data + sizeof(Header));
+    }
+
+    std::string_view text(uint64_t offset, uint32_t length) const noexcept {
+        return {m_data + offset, length};
+    }
+
+    Entry makeEntry(Record const& record) const {
+        return {std::string(text(record.keyOffset, record.keyLength)),
+                std::string(text(record.locationOffset, record.locationLength)),
+                record.size,
+                toTimePoint(record.lastAccess)};
+    }
+
+    Record const* findRecord(std::string_view key) const noexcept {
+        auto const begin = records();
+        auto const end = begin + m_count;
+        auto const record = std::lower_bound(begin, end, key, [this] (Record const& record, std::string_view key) {
+            return text(record.keyOffset, record.keyLength) < key;
+        });
+
+        if (record == end or text(record->keyOffset, record->keyLength) != key) {
+            return nullptr;
+        }
+        return record;
+    }
+
+    static int64_t fromTimePoint(std::chrono::system_clock::time_point time) noexcept {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(time.time_since_epoch()).count();
+    }
+
+    static std::chrono::system_clock::time_point toTimePoint(int64_t time) noexcept {
+        return std::chrono::system_clock::time_point(
+            std::chrono::duration_cast<std::chrono::system_clock::duration>(std::chrono::nanoseconds(time)));
+    }
+
+    void writeJournal(Operation operation, Entry const& entry) {
+        serde::serialize(m_journal, static_cast<uint8_t>(operation));
+        serde::serialize(m_journal, entry.key);
+        serde::serialize(m_journal, entry.location);
+        serde::serialize(m_journal, entry.size);
+        serde::serialize(m_journal, fromTimePoint(entry.lastAccess));
+        if (not m_journal.flush()) {
+            throw std::logic_error("Can't write manifest journal: " + m_journalPath);
+        }
+    }
+
+    // A torn record at the end of the journal is ignored.
+    void replayJournal() {
+        std::ifstream stream(m_journalPath, std::ios::binary);
+        while (stream.is_open()) {
+            auto const operation = serde::deserialize<uint8_t>(stream);
+            auto key = serde::deserialize<std::string>(stream);
+            auto location = serde::deserialize<std::string>(stream);
+            auto const size = serde::deserialize<uint64_t>(stream);
+            auto const lastAccess = serde::deserialize<int64_t>(stream);
+            if (not lastAccess.has_value() or stream.fail()) {
+                break;
+            }
+
+            if (*operation == Erase) {
+                m_changes.insert_or_assign(*key, std::nullopt);
+            } else {
+                auto const name = *key;
+                m_changes.insert_or_assign(name, Entry {std::move(*key), std::move(*location), *size, toTimePoint(*lastAccess)});
+            }
+        }
+    }
+
+    void writeCheckpoint(std::vector<Entry> const& entries) {
+        auto const temporary = m_checkpointPath + ".tmp";
+        {
+            std::ofstream stream(temporary, std::ios::binary | std::ios::trunc);
+            Header const header {magic, version, entries.size()};
+            stream.write(reinterpret_cast<char const*>(&header), sizeof(header));
+
+            uint64_t offset = sizeof(Header) + entries.size() * sizeof(Record);
+            for (auto const& entry: entries) {
+                Record record {};
+                record.keyOffset = offset;
+                record.keyLength = static_cast<uint32_t>(entry.key.size());
+                record.locationOffset = offset + entry.key.size();
+                record.locationLength = static_cast<uint32_t>(entry.location.size());
+                record.size = entry.size;
+                record.lastAccess = fromTimePoint(entry.lastAccess);
+                stream.write(reinterpret_cast<char const*>(&record), sizeof(record));
+                offset += entry.key.size() + entry.location.size();
+            }
+
+            for (auto const& entry: entries) {
+                stream.write(entry.key.data(), static_cast<std::streamsize>(entry.key.size()));
+                stream.write(entry.location.data(), static_cast<std::streamsize>(entry.location.size()));
+            }
+
+            if (not stream.flush()) {
+                throw std::logic_error("Can't write manifest: " + temporary);
+            }
+        }
+
+        unmapCheckpoint();
+        std::filesystem::rename(temporary, m_checkpointPath);
+        m_changes.clear();
+        m_journal.close();
+        m_journal.open(m_journalPath, std::ios::binary | std::ios::trunc);
+        if (not mapCheckpoint()) {
+            throw std::logic_error("Invalid manifest: " + m_checkpointPath);
+        }
+        m_rejected = false;
+    }
+
+    // Returns false and leaves nothing mapped when the checkpoint is damaged.
+    bool mapCheckpoint() {
+        if (not std::filesystem::exists(m_checkpointPath)) {
+            return true;
+        }
+
+#if defined(BINARY_STORAGE_MANIFEST_MMAP)
+        auto const fd = open(m_checkpointPath.c_str(), O_RDONLY | O_CLOEXEC);
+        struct stat info {};
+        if (fd < 0 or fstat(fd, &info) != 0) {
+            if (fd >= 0) {
+                close(fd);
+            }
+            throw std::logic_error("Can't open manifest: " + m_checkpointPath);
+        }
+
+        m_dataSize = static_cast<size_t>(info.st_size);
+        if (m_dataSize != 0) {
+            auto const data = mmap(nullptr, m_dataSize, PROT_READ, MAP_SHARED, fd, 0);
+            m_data = data == MAP_FAILED ? nullptr : static_cast<char const*>(data);
+        }
+        close(fd);
+#else
+        std::ifstream stream(m_checkpointPath, std::ios::binary);
+        m_buffer.assign(std::istreambuf_iterator<char>(stream), {});
+        m_data = m_buffer.data();
+        m_dataSize = m_buffer.size();
+#endif
+
+        if (not validCheckpoint()) {
+            unmapCheckpoint();
+            return false;
+        }
+        return true;
+    }
+
+    // Every record must point at text past the records and inside the file,
+    // and the keys must be strictly ascending for the binary search.
+    bool validCheckpoint() noexcept {
+        Header header {};
+        if (m_data == nullptr or m_dataSize < sizeof(Header)) {
+            return false;
+        }
+
+        std::memcpy(&header, m_data, sizeof(header));
+        if (header.magic != magic or header.version != version
+            or header.count > (m_dataSize - sizeof(Header)) / sizeof(Record)) {
+            return false;
+        }
+
+        auto const textBegin = sizeof(Header) + header.count * sizeof(Record);
+        auto const inText = [&] (uint64_t offset, uint32_t length) {
+            return offset >= textBegin and offset <= m_dataSize and length <= m_dataSize - offset;
+        };
+
+        m_count = header.count;
+        for (size_t i = 0; i < m_count; ++i) {
+            auto const& record = records()[i];
+            if (not inText(record.keyOffset, record.keyLength) or not inText(record.locationOffset, record.locationLength)
+                or (i != 0 and text(records()[i - 1].keyOffset, records()[i - 1].keyLength)
+                                   >= text(record.keyOffset, record.keyLength))) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    void unmapCheckpoint() noexcept {
+#if defined(BINARY_STORAGE_MANIFEST_MMAP)
+        if (m_data != nullptr) {
+            munmap(const_cast<char*>(m_data), m_dataSize);
+        }
+#else
+        m_buffer.clear();
+#endif
+        m_data = nullptr;
+        m_dataSize = 0;
+        m_count = 0;
+    }
+};
+
+} // namespace binary_storage::storage
@@ -1,17 +1,47 @@
 #pragma once
 
+#include <chrono>
 #include <string>
 #include <cstdint>
+#include <memory>
 
 namespace binary_storage::storage {
+
+class EvictionPolicy;
+
+enum class DiskEngineKind {
+    Auto,
+    ThreadPool,
+    IoUring
+};
     
 struct BaseParameters {
     std::string path {""};
     std::string extension {".bin"};
     size_t cashSize {20};
+    size_t cashBytes {0};
     double resizeCoeff {1.5};
     bool saveAllOnDestruct {false};
     bool loadAllOnCreate {false};
+    size_t serializedCacheSize {0};
+    bool compressSerialized {false};
+    std::shared_ptr<EvictionPolicy> evictionPolicy;
+    DiskEngineKind diskEngine {DiskEngineKind::Auto};
+    size_t ioThreads {4};
+    unsigned ioQueueDepth {64};
+    bool useManifest {false};
+    size_t manifestCheckpointInterval {10000};
+    size_t chunkElements {0};
+    bool columnar {false};
+    size_t serdeThreads {0};
+    bool lockFreeReads {false};
+    std::string sharedMemoryName {""};
+    size_t sharedMemoryBytes {64 * 1024 * 1024};
+    size_t fanOutLevels {0};
+    bool encodeKeys {false};
+    size_t keyFilterBits {10};
+    std::chrono::milliseconds ttlResolution {100};
+    std::chrono::milliseconds backgroundInterval {1000};
 };
 
 } // namespace binary_storage::storage
@@ -0,0 +1,261 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace binary_storage::storage {
+
+// Epoch based reclamation for data read without locks. A reader announces the
+// global epoch in a slot on a cache line of its own while it reads, objects
+// unlinked by writers are freed once every announced epoch is newer than the
+// one they were retired at. Readers never write a shared cache line, writers
+// have to be serialized by the caller.
+class EpochDomain {
+   public:
+    static constexpr size_t slotsCount {128};
+
+    class Guard {
+       public:
+        Guard(Guard const&) = delete;
+        Guard(Guard&&) noexcept = delete;
+        Guard& operator=(Guard const&) = delete;
+        Guard& operator=(Guard&&) noexcept = delete;
+
+        ~Guard() noexcept {
+            m_slot->store(0, std::memory_order_release);
+        }
+
+       private:
+        friend class EpochDomain;
+
+        explicit Guard(std::atomic<uint64_t>* slot) noexcept :
+            m_slot {slot} {}
+
+        std::atomic<uint64_t>* m_slot;
+    };
+
+   public:
+    EpochDomain() = default;
+    EpochDomain(EpochDomain const&) = delete;
+    EpochDomain(EpochDomain&&) noexcept = delete;
+    EpochDomain& operator=(EpochDomain const&) = delete;
+    EpochDomain& operator=(EpochDomain&&) noexcept = delete;
+
+   public:
+    // Every thread starts from a slot of its own, with more than slotsCount
+    // concurrent readers the extra ones wait for a free slot.
+    Guard enter() const noexcept {
+        auto& hint = slotHint();
+        auto const epoch = m_epoch.load();
+        for (size_t i = hint;; i = (i + 1) % slotsCount) {
+            uint64_t expected = 0;
+            if (m_slots[i].epoch.compare_exchange_strong(expected, epoch)) {
+                hint = i;
+                return Guard(&m_slots[i].epoch);
+            }
+        }
+    }
+
+    // Frees the object once no reader that could have seen it is left.
+    void retire(std::shared_ptr<void const> object) {
+        auto const epoch = m_epoch.fetch_add(1);
+        m_retired.push_back({epoch, std::move(object)});
+        if (m_retired.size() >= reclaimThreshold) {
+            reclaim();
+        }
+    }
+
+    void reclaim() {
+        auto oldest = std::numeric_limits<uint64_t>::max();
+        for (auto const& slot: m_slots) {
+            auto const epoch = slot.epoch.load();
+            if (epoch != 0) {
+                oldest = std::min(oldest, epoch);
+            }
+        }
+
+        m_retired.erase(std::remove_if(m_retired.begin(), m_retired.end(), [oldest] (Retired const& retired) {
+            return retired.epoch < oldest;
+        }), m_retired.end());
+    }
+
+    size_t retiredCount() const noexcept {
+        return m_retired.size();
+    }
+
+   private:
+    static constexpr size_t reclaimThreshold {64};
+
+    struct alignas(64) Slot {
+        std::atomic<uint64_t> epoch {0};
+    };
+
+    struct Retired {
+        uint64_t epoch;
+        std::shared_ptr<void const> object;
+    };
+
+    static size_t& slotHint() noexcept {
+        static std::atomic<size_t> threads {0};
+        thread_local size_t hint = threads.fetch_add(1, std::memory_order_relaxed) % slotsCount;
+        return hint;
+    }
+
+    mutable Slot m_slots[slotsCount];
+    std::atomic<uint64_t> m_epoch {1};
+    std::vector<Retired> m_retired;
+};
+
+// Hash table of immutable values that readers look up without locks. Each
+// bucket is an immutable array that writers copy, change and publish with a
+// single atomic store, replaced arrays are reclaimed through an EpochDomain.
+// Values are shared between the arrays, so a change copies only pointers.
+// The number of buckets is fixed.
+template<class T>
+class ReadIndex {
+   public:
+    explicit ReadIndex(size_t buckets) :
+        m_mask {bucketsCount(buckets) - 1},
+        m_buckets(new std::atomic<Bucket const*>[m_mask + 1]),
+        m_owned(m_mask + 1) {
+        for (size_t i = 0; i <= m_mask; ++i) {
+            m_buckets[i].store(nullptr, std::memory_order_relaxed);
+        }
+    }
+
+    ReadIndex(ReadIndex const&) = delete;
+    ReadIndex(ReadIndex&&) noexcept = delete;
+    ReadIndex& operator=(ReadIndex const&) = delete;
+    ReadIndex& operator=(ReadIndex&&) noexcept = delete;
+
+   public:
+    // Calls visit with the published value, returns false when the key is not published.
+    template<class F>
+    bool visit(std::string_view key, F&& function) const {
+        auto const guard = m_domain.enter();
+        auto const bucket = m_buckets[index(key)].load();
+        if (bucket == nullptr) {
+            return false;
+        }
+
+        for (auto const& entry: *bucket) {
+            if (entry.key == key) {
+                function(*entry.value);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Publishes the value when current() still holds under the writer lock.
+    template<class F>
+    bool publish(std::string const& key, std::shared_ptr<T const> value, F&& current) {
+        std::lock_guard lock(m_writer);
+        if (not current()) {
+            return false;
+        }
+
+        auto const i = index(key);
+        auto bucket = m_owned[i] == nullptr ? std::make_shared<Bucket>() : std::make_shared<Bucket>(*m_owned[i]);
+        auto const entry = std::find_if(bucket->begin(), bucket->end(), [&key] (Entry const& entry) {
+            return entry.key == key;
+        });
+
+        if (entry == bucket->end()) {
+            bucket->push_back({key, std::move(value)});
+            ++m_size;
+        } else {
+            entry->value = std::move(value);
+        }
+        replace(i, std::move(bucket));
+        return true;
+    }
+
+    void unpublish(std::string_view key) {
+        std::lock_guard lock(m_writer);
+        auto const i = index(key);
+        if (m_owned[i] == nullptr) {
+            return;
+        }
+
+        auto const entry = std::find_if(m_owned[i]->begin(), m_owned[i]->end(), [key] (Entry const& entry) {
+            return entry.key == key;
+        });
+        if (entry == m_owned[i]->end()) {
+            return;
+        }
+
+        std::shared_ptr<Bucket> bucket;
+        if (m_owned[i]->size() > 1) {
+            bucket = std::make_shared<Bucket>(*m_owned[i]);
+            bucket->erase(bucket->begin() + (entry - m_owned[i]->begin()));
+        }
+        --m_size;
+        replace(i, std::move(bucket));
+    }
+
+    void clear() {
+        std::lock_guard lock(m_writer);
+        for (size_t i = 0; i <= m_mask; ++i) {
+            if (m_owned[i] != nullptr) {
+                replace(i, nullptr);
+            }
+        }
+        m_size = 0;
+    }
+
+    size_t size() const {
+        std::lock_guard lock(m_writer);
+        return m_size;
+    }
+
+    size_t retiredCount() const {
+        std::lock_guard lock(m_writer);
+        return m_domain.retiredCount();
+    }
+
+   private:
+    struct Entry {
+        std::string key;
+        std::shared_ptr<T const> value;
+    };
+
+    using Bucket = std::vector<Entry>;
+
+    static size_t bucketsCount(size_t buckets) noexcept {
+        size_t count = 1;
+        while (count < buckets) {
+            count <<= 1;
+        }
+        return count;
+    }
+
+    size_t index(std::string_view key) const noexcept {
+        return std::hash<std::string_view> {}(key) & m_mask;
+    }
+
+    void replace(size_t i, std::shared_ptr<Bucket const> bucket) {
+        m_buckets[i].store(bucket.get());
+        if (m_owned[i] != nullptr) {
+            m_domain.retire(std::move(m_owned[i]));
+        }
+        m_owned[i] = std::move(bucket);
+    }
+
+    size_t m_mask;
+    std::unique_ptr<std::atomic<Bucket const*>[]> m_buckets;
+    std::vector<std::shared_ptr<Bucket const>> m_owned;
+    size_t m_size {0};
+    mutable std::mutex m_writer;
+    mutable EpochDomain m_domain;
+};
+
+} // namespace binary_storage::storage
@@ -0,0 +1,434 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#if defined(__linux__) and __has_include(<sys/mman.h>)
+#include <cerrno>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define BINARY_STORAGE_SHARED_MEMORY 1
+#endif
+
+#include "FileLayout.hpp"
+
+namespace binary_storage::storage {
+
+// Cache of file contents shared by the processes of a host: a file-backed
+// memory mapping under /dev/shm with an open addressing table of entries and
+// a ring of data that overwrites the oldest entries once it is full. Entries
+// are keyed by the file path and stamped with the inode, size and mtime of
+// the file. A file rewritten within one tick of a coarse filesystem clock can
+// keep its stamp, so writers sharing the segment erase the entry of a file
+// once they have rewritten it, which also bumps a generation counter: a
+// reader puts what it read only when no entry was erased since it started
+// reading. Files rewritten by other programs are only caught by the stamp.
+// All access goes through a robust process-shared mutex, a process that dies
+// holding it leaves the cache cleared.
+class SharedSegment {
+   public:
+    struct Stamp {
+        uint64_t inode {0};
+        uint64_t size {0};
+        int64_t modified {0};
+
+        bool operator==(Stamp const& other) const noexcept {
+            return inode == other.inode and size == other.size and modified == other.modified;
+        }
+    };
+
+#if defined(BINARY_STORAGE_SHARED_MEMORY)
+   public:
+    SharedSegment(std::string const& name, size_t bytes) :
+        m_path {"/dev/shm/" + name} {
+        auto const minimum = sizeof(Header) + minimumSlots * sizeof(Slot) + minimumSlots;
+        if (bytes < minimum) {
+            throw std::logic_error("Shared memory segment is too small: " + m_path);
+        }
+
+        auto fd = open(m_path.c_str(), O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0600);
+        auto const created = fd >= 0;
+        if (not created) {
+            fd = open(m_path.c_str(), O_RDWR | O_CLOEXEC);
+        }
+        if (fd < 0 or (created and ftruncate(fd, static_cast<off_t>(bytes)) != 0)) {
+            if (fd >= 0) {
+                close(fd);
+            }
+            throw std::logic_error("Can't open shared memory segment: " + m_path);
+        }
+
+        m_size = created ? bytes : waitForSize(fd);
+        auto const data = m_size == 0 ? MAP_FAILED : mmap(nullptr, m_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        close(fd);
+        if (data == MAP_FAILED) {
+            throw std::logic_error("Can't map shared memory segment: " + m_path);
+        }
+
+        m_data = static_cast<char*>(data);
+        if (created) {
+            initialize();
+        } else {
+            waitForReady();
+            if (header().slots != slotsCount(m_size)) {
+                munmap(m_data, m_size);
+                throw std::logic_error("Invalid shared memory segment: " + m_path);
+            }
+        }
+    }
+
+    SharedSegment(SharedSegment const&) = delete;
+    SharedSegment(SharedSegment&&) noexcept = delete;
+    SharedSegment& operator=(SharedSegment const&) = delete;
+    SharedSegment& operator=(SharedSegment&&) noexcept = delete;
+
+    ~SharedSegment() noexcept {
+        munmap(m_data, m_size);
+    }
+
+   public:
+    static std::optional<Stamp> fileStamp(std::string const& path) noexcept {
+        struct stat info {};
+        if (stat(path.c_str(), &info) != 0) {
+            return std::nullopt;
+        }
+
+        auto const modified = std::chrono::seconds(info.st_mtim.tv_sec) + std::chrono::nanoseconds(info.st_mtim.tv_nsec);
+        return Stamp {static_cast<uint64_t>(info.st_ino),
+                      static_cast<uint64_t>(info.st_size),
+                      std::chrono::duration_cast<std::chrono::nanoseconds>(modified).count()};
+    }
+
+    // Removes the segment file, processes that have it mapped keep using it.
+    static void remove(std::string const& name) noexcept {
+        unlink(("/dev/shm/" + name).c_str());
+    }
+
+    std::optional<std::string> get(std::string_view key, Stamp const& stamp) const {
+        Lock const lock(*this);
+        auto const slot = findSlot(key);
+        if (slot == nullptr or not (slot->stamp == stamp)) {
+            return std::nullopt;
+        }
+        return std::string(data() + slot->offset + slot->keyLength, slot->size);
+    }
+
+    // Read before the file it caches is read, see put.
+    uint64_t generation() const {
+        Lock const lock(*this);
+        return header().generation;
+    }
+
+    // Returns false when the entry does not fit into the data ring, or when
+    // generation is given and an entry was erased since it was read.
+    bool put(std::string_view key, Stamp const& stamp, std::string_view bytes, std::optional<uint64_t> generation = std::nullopt) {
+        auto const need = key.size() + bytes.size();
+        if (need > dataSize()) {
+            return false;
+        }
+
+        Lock const lock(*this);
+        auto& header = this->header();
+        if (generation.has_value() and *generation != header.generation) {
+            return false;
+        }
+        if (header.head + need > dataSize()) {
+            header.head = 0;
+        }
+        invalidate(header.head, header.head + need);
+
+        auto slot = insertSlot(key);
+        if (slot == nullptr) {
+            clearSlots();
+            slot = insertSlot(key);
+        }
+
+        std::memcpy(data() + header.head, key.data(), key.size());
+        std::memcpy(data() + header.head + key.size(), bytes.data(), bytes.size());
+        slot->hash = hash(key);
+        slot->offset = header.head;
+        slot->keyLength = static_cast<uint32_t>(key.size());
+        slot->size = bytes.size();
+        slot->stamp = stamp;
+        slot->state = Used;
+        header.head += need;
+        return true;
+    }
+
+    // Drops the entry of a rewritten file and bumps the generation.
+    void erase(std::string_view key) {
+        Lock const lock(*this);
+        auto& header = this->header();
+        ++header.generation;
+        if (auto const slot = findSlot(key); slot != nullptr) {
+            slot->state = Deleted;
+            --header.count;
+            ++header.deleted;
+            if (header.deleted > header.slots / 4) {
+                rehash();
+            }
+        }
+    }
+
+    void clear() {
+        Lock const lock(*this);
+        clearSlots();
+    }
+
+    size_t count() const {
+        Lock const lock(*this);
+        return header().count;
+    }
+
+   private:
+    static constexpr uint32_t magic {0x53485344};
+    static constexpr size_t minimumSlots {64};
+    static constexpr size_t bytesPerSlot {4096};
+
+    enum State : uint32_t { Empty = 0, Used = 1, Deleted = 2 };
+
+    struct Header {
+        std::atomic<uint32_t> magic;
+        uint32_t padding;
+        uint64_t slots;
+        uint64_t head;
+        uint64_t count;
+        uint64_t deleted;
+        uint64_t generation;
+        pthread_mutex_t mutex;
+    };
+
+    struct Slot {
+        uint64_t hash;
+        uint64_t offset;
+        uint64_t size;
+        Stamp stamp;
+        uint32_t keyLength;
+        uint32_t state;
+    };
+
+    class Lock {
+       public:
+        explicit Lock(SharedSegment const& segment) :
+            m_segment {segment} {
+            auto const result = pthread_mutex_lock(&m_segment.header().mutex);
+            if (result == EOWNERDEAD) {
+                pthread_mutex_consistent(&m_segment.header().mutex);
+                const_cast<SharedSegment&>(m_segment).clearSlots();
+            } else if (result != 0) {
+                throw std::logic_error("Can't lock shared memory segment: " + m_segment.m_path);
+            }
+        }
+
+        Lock(Lock const&) = delete;
+        Lock& operator=(Lock const&) = delete;
+
+        ~Lock() noexcept {
+            pthread_mutex_unlock(&m_segment.header().mutex);
+        }
+
+       private:
+        SharedSegment const& m_segment;
+    };
+
+    std::string m_path;
+    char* m_data {nullptr};
+    size_t m_size {0};
+
+   private:
+    Header& header() const noexcept {
+        return *reinterpret_cast<Header*>(m_data);
+    }
+
+    Slot* slots() const noexcept {
+        return reinterpret_cast<Slot*>(m_data + sizeof(Header));
+    }
+
+    char* data() const noexcept {
+        return m_data + sizeof(Header) + header().slots * sizeof(Slot);
+    }
+
+    size_t dataSize() const noexcept {
+        return m_size - sizeof(Header) - header().slots * sizeof(Slot);
+    }
+
+    // Stable across processes, whatever standard library they were built with.
+    static uint64_t hash(std::string_view key) noexcept {
+        return keyHash(key);
+    }
+
+    static size_t slotsCount(size_t bytes) noexcept {
+        return std::max<size_t>(minimumSlots, bytes / bytesPerSlot);
+    }
+
+    bool matches(Slot const& slot, std::string_view key, uint64_t keyHash) const noexcept {
+        return slot.state == Used and slot.hash == keyHash and slot.keyLength == key.size()
+               and std::memcmp(data() + slot.offset, key.data(), key.size()) == 0;
+    }
+
+    Slot* findSlot(std::string_view key) const noexcept {
+        auto const keyHash = hash(key);
+        auto const count = header().slots;
+        for (size_t i = 0; i < count; ++i) {
+            auto& slot = slots()[(keyHash + i) % count];
+            if (slot.state == Empty) {
+                return nullptr;
+            }
+            if (matches(slot, key, keyHash)) {
+                return &slot;
+            }
+        }
+        return nullptr;
+    }
+
+    // The slot of the key or a free one for it, nullptr when the table is full.
+    Slot* insertSlot(std::string_view key) noexcept {
+        if (auto const slot = findSlot(key); slot != nullptr) {
+            return slot;
+        }
+
+        auto const keyHash = hash(key);
+        auto& header = this->header();
+        for (size_t i = 0; i < header.slots; ++i) {
+            auto& slot = slots()[(keyHash + i) % header.slots];
+            if (slot.state != Used) {
+                header.deleted -= slot.state == Deleted ? 1 : 0;
+                ++header.count;
+                return &slot;
+            }
+        }
+        return nullptr;
+    }
+
+    // Drops the entries whose data overlaps [begin, end) of the ring.
+    void invalidate(uint64_t begin, uint64_t end) {
+        auto& header = this->header();
+        for (size_t i = 0; i < header.slots; ++i) {
+            auto& slot = slots()[i];
+            if (slot.state == Used and slot.offset < end and begin < slot.offset + slot.keyLength + slot.size) {
+                slot.state = Deleted;
+                --header.count;
+                ++header.deleted;
+            }
+        }
+
+        if (header.deleted > header.slots / 4) {
+            rehash();
+        }
+    }
+
+    // Reinserts the live entries to get rid of the deleted markers. The table
+    // is left as it was when the live entries can't be collected.
+    void rehash() {
+        auto& header = this->header();
+        std::vector<Slot> live;
+        for (size_t i = 0; i < header.slots; ++i) {
+            if (slots()[i].state == Used) {
+                live.push_back(slots()[i]);
+            }
+        }
+
+        std::memset(static_cast<void*>(slots()), 0, header.slots * sizeof(Slot));
+        for (auto const& entry: live) {
+            for (size_t i = 0;; ++i) {
+                auto& slot = slots()[(entry.hash + i) % header.slots];
+                if (slot.state == Empty) {
+                    slot = entry;
+                    break;
+                }
+            }
+        }
+        header.deleted = 0;
+    }
+
+    void clearSlots() noexcept {
+        auto& header = this->header();
+        std::memset(static_cast<void*>(slots()), 0, header.slots * sizeof(Slot));
+        header.head = 0;
+        header.count = 0;
+        header.deleted = 0;
+    }
+
+    void initialize() {
+        auto& header = this->header();
+        header.slots = slotsCount(m_size);
+        header.generation = 0;
+        clearSlots();
+
+        pthread_mutexattr_t attributes;
+        pthread_mutexattr_init(&attributes);
+        pthread_mutexattr_setpshared(&attributes, PTHREAD_PROCESS_SHARED);
+        pthread_mutexattr_setrobust(&attributes, PTHREAD_MUTEX_ROBUST);
+        pthread_mutex_init(&header.mutex, &attributes);
+        pthread_mutexattr_destroy(&attributes);
+        header.magic.store(magic, std::memory_order_release);
+    }
+
+    // The creator sizes the file right after creating it.
+    size_t waitForSize(int fd) const {
+        for (size_t attempt = 0; attempt < 1000; ++attempt) {
+            struct stat info {};
+            if (fstat(fd, &info) == 0 and info.st_size != 0) {
+                return static_cast<size_t>(info.st_size);
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        return 0;
+    }
+
+    void waitForReady() const {
+        for (size_t attempt = 0; attempt < 1000; ++attempt) {
+            if (header().magic.load(std::memory_order_acquire) == magic) {
+                return;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        throw std::logic_error("Invalid shared memory segment: " + m_path);
+    }
+#else
+   public:
+    SharedSegment(std::string const& name, size_t) {
+        throw std::logic_error("Shared memory segments are not supported: " + name);
+    }
+
+    static std::optional<Stamp> fileStamp(std::string const&) noexcept {
+        return std::nullopt;
+    }
+
+    static void remove(std::string const&) noexcept {}
+
+    std::optional<std::string> get(std::string_view, Stamp const&) const {
+        return std::nullopt;
+    }
+
+    uint64_t generation() const {
+        return 0;
+    }
+
+    bool put(std::string_view, Stamp const&, std::string_view, std::optional<uint64_t> = std::nullopt) {
+        return false;
+    }
+
+    void erase(std::string_view) {}
+
+    void clear() {}
+
+    size_t count() const {
+        return 0;
+    }
+#endif
+};
+
+} // namespace binary_storage::storage
@@ -7,10 +7,26 @@
 #include <unordered_map>
 #include <filesystem>
 #include <map>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <limits>
 
 #include "serde/traits.hpp"
 #include "ValueStorage.hpp"
 #include "Parameters.hpp"
+#include "DiskEngine.hpp"
+#include "EvictionPolicy.hpp"
+#include "Manifest.hpp"
+#include "Archive.hpp"
+#include "ReadIndex.hpp"
+#include "SharedSegment.hpp"
+#include "FileLayout.hpp"
+#include "KeyFilter.hpp"
+#include "TimingWheel.hpp"
+#include "DeltaLog.hpp"
+#include "Async.hpp"
 
 namespace binary_storage::storage {
 
@@ -22,8 +38,28 @@ class Storage {
 
    public:
     Storage(BaseParameters params) :
-        m_paramters {std::move(params)} {
+        m_paramters {std::move(params)},
+        m_encoding {m_paramters.chunkElements, m_paramters.columnar, {}} {
+        if (m_paramters.evictionPolicy == nullptr) {
+            m_paramters.evictionPolicy = std::make_shared<RecencyPolicy>();
+        }
+        if (m_paramters.serdeThreads > 1) {
+            m_serdePool = std::make_unique<ThreadPool>(m_paramters.serdeThreads - 1);
+            m_encoding.parallelFor = [pool = m_serdePool.get()] (size_t count, std::function<void(size_t)> const& task) {
+                pool->parallelFor(count, task);
+            };
+        }
+        if (m_paramters.lockFreeReads) {
+            m_readIndex = std::make_unique<ReadIndex<ValueType>>(std::max<size_t>(m_paramters.cashSize, 64));
+        }
+        if (not m_paramters.sharedMemoryName.empty()) {
+            m_shared = std::make_unique<SharedSegment>(m_paramters.sharedMemoryName, m_paramters.sharedMemoryBytes);
+        }
         loadFiles();
+        loadDeltas();
+        if (not m_paramters.useManifest) {
+            rebuildFilter();
+        }
     }
     
     Storage(Storage const&) = delete;
@@ -33,59 +69,446 @@ class Storage {
     
     ~Storage() noexcept {
         if (m_paramters.saveAllOnDestruct) {
-            for (auto& node: m_container) {
-                storeValue(node.second, m_paramters.path + node.first + m_paramters.extension);
+            try {
+                flush().wait();
+            } catch (...) {
+            }
+        }
+        m_engine.reset();
+
+        if (m_manifest != nullptr) {
+            try {
+                m_manifest->checkpoint();
+            } catch (...) {
             }
         }
     }
 
+    // Point-in-time view of the storage. Values stored, modified through load or
+    // erased after it was taken keep their previous version for it, readers of
+    // the view take the shared lock per key only. Must not outlive the storage.
+    class Snapshot {
+       public:
+        Snapshot(Snapshot const&) = delete;
+        Snapshot& operator=(Snapshot const&) = delete;
+        Snapshot& operator=(Snapshot&&) noexcept = delete;
+
+        Snapshot(Snapshot&& other) noexcept :
+            m_storage {std::exchange(other.m_storage, nullptr)},
+            m_epoch {other.m_epoch} {}
+
+        ~Snapshot() noexcept {
+            if (m_storage != nullptr) {
+                m_storage->release(m_epoch);
+            }
+        }
+
+        ValueType load(std::string const& key) const {
+            auto data = m_storage->versionData(key, m_epoch);
+            if (not data.has_value()) {
+                throw std::logic_error("Key not found: " + key);
+            }
+            return std::move(*data);
+        }
+
+        bool contains(std::string const& key) const {
+            std::shared_lock lock(m_storage->m_mutex);
+            return m_storage->visitVersion(key, m_epoch, [] (Value<ValueType> const&) {});
+        }
+
+        // Sorted keys of the view.
+        std::vector<std::string> keys() const {
+            return m_storage->versionKeys(m_epoch);
+        }
+
+        template<class F>
+        void forEach(F&& function) const {
+            for (auto const& key: keys()) {
+                function(key, load(key));
+            }
+        }
+
+        uint64_t epoch() const noexcept {
+            return m_epoch;
+        }
+
+       private:
+        friend class Storage;
+
+        Snapshot(Storage* storage, uint64_t epoch) :
+            m_storage {storage},
+            m_epoch {epoch} {}
+
+        Storage* m_storage;
+        uint64_t m_epoch;
+    };
+
    public:
+    // Throws std::logic_error for a key too long to name its files, see
+    // encodeKey.
     void store(std::string const& key, ValueType&& value) {
-        std::unique_lock lock(m_mutex);
-        m_container[key] = createFromData(std::forward<ValueType>(value));
+        storeImpl(key, std::forward<ValueType>(value));
+    }
+
+    // Stores the value for the given time to live, rounded up to ttlResolution.
+    // An expired value is missing for every read and is erased by the next
+    // expire call. Storing the key again without a TTL keeps it.
+    void store(std::string const& key, ValueType&& value, std::chrono::milliseconds ttl) {
+        storeImpl(key, std::forward<ValueType>(value), ttl);
     }
 
+    // The returned reference may be used to modify the value, so it will be
+    // written again on eviction and by every flush until then, changes made
+    // through it after a flush included. Use loadConst for read-only access.
     ValueType& load(std::string const& key) {
-        std::shared_lock lock(m_mutex);
-        auto const iter = m_container.find(key);
-        if (iter == m_container.end()) {
-            throw std::logic_error("Key not found: " + key);
+        m_paramters.evictionPolicy->recordAccess(key);
+        return loadImpl(key, true);
+    }
+
+    // Read-only access: a value reloaded from its file stays clean and its
+    // eviction only drops the in-memory copy.
+    ValueType const& loadConst(std::string const& key) {
+        m_paramters.evictionPolicy->recordAccess(key);
+        return loadImpl(key, false);
+    }
+
+    // Calls visit with the value without copying it. With lockFreeReads set,
+    // resident values are looked up in an index that readers access without
+    // touching the storage lock, a miss publishes a copy of the value there
+    // until it is stored, erased, evicted or loaded for modification. Values
+    // with a time to live are never published, so they are read under the
+    // lock. Values must not be modified through references kept from an
+    // earlier load.
+    template<class F>
+    void read(std::string const& key, F&& visit) {
+        m_paramters.evictionPolicy->recordAccess(key);
+        if (m_readIndex != nullptr and m_readIndex->visit(key, visit)) {
+            return;
         }
 
-        return getData(iter->second);
+        while (true) {
+            std::shared_ptr<ValueType const> data;
+            {
+                std::shared_lock lock(m_mutex);
+                auto const iter = m_container.find(key);
+                if ((iter == m_container.end() and m_unloaded == 0) or isExpired(key)) {
+                    throw std::logic_error("Key not found: " + key);
+                }
+
+                if (iter != m_container.end() and isCashed(iter->second)) {
+                    auto const& value = std::get<ValueType>(iter->second.storage);
+                    if (m_readIndex == nullptr or (not m_expiry.empty() and m_expiry.count(key) != 0)) {
+                        visit(value);
+                        return;
+                    }
+
+                    auto const revision = iter->second.revision.current();
+                    data = std::make_shared<ValueType const>(value);
+                    m_readIndex->publish(key, data, [&revision, &value = iter->second] {
+                        return value.revision.current() == revision;
+                    });
+                }
+            }
+
+            if (data != nullptr) {
+                visit(*data);
+                return;
+            }
+            loadImpl(key, false);
+        }
+    }
+
+    ValueType read(std::string const& key) {
+        std::optional<ValueType> result;
+        read(key, [&result] (ValueType const& value) { result = value; });
+        return std::move(*result);
+    }
+
+    // Returns copies of the given members, e.g. loadFields<&Rec::id, &Rec::ts>(key).
+    // Evicted values are decoded member by member skipping the rest and are
+    // neither made resident nor touched in the tier.
+    template<auto... Members>
+    serde::Projection<Members...> loadFields(std::string const& key) {
+        return readShared(key, [] (Value<ValueType> const& value, Encoding const&) {
+            return projectValue<Members...>(value);
+        });
+    }
+
+    // Returns whole columns of a stored vector of records, e.g. 
+    // loadColumns<&Rec::id, &Rec::ts>(key) gives the ids and the timestamps of
+    // all records. With columnar set only the requested columns are decoded.
+    template<auto... Members>
+    serde::Columns<Members...> loadColumns(std::string const& key) {
+        return readShared(key, [] (Value<ValueType> const& value, Encoding const& encoding) {
+            return columnsValue<Members...>(value, encoding);
+        });
+    }
+
+    // Returns the elements [begin, end) of a stored vector, end is clamped to
+    // its size. Evicted values are read from the chunk holding begin when
+    // chunkElements is set, the value is not made resident.
+    template<class U = ValueType, class = std::enable_if_t<serde::isContiguous<U>>>
+    ValueType loadSlice(std::string const& key, size_t begin, size_t end) {
+        return readShared(key, [begin, end] (Value<ValueType> const& value, Encoding const& encoding) {
+            return sliceValue(value, begin, end, encoding);
+        });
+    }
+
+    // Appends the elements to a stored vector and returns its new length. An
+    // evicted value is not read: the elements go to a delta log of the key,
+    // which is merged into the value on its next load, by compact, or once the
+    // log outgrows the value's file.
+    template<class U = ValueType, class = std::enable_if_t<serde::isContiguous<U>>>
+    size_t append(std::string const& key, ValueType const& elements) {
+        return updateVector(key, std::nullopt, elements);
+    }
+
+    // Overwrites the elements of a stored vector from offset on, they must be
+    // within its length. Evicted values take a delta record as with append.
+    template<class U = ValueType, class = std::enable_if_t<serde::isContiguous<U>>>
+    void patch(std::string const& key, size_t offset, ValueType const& elements) {
+        updateVector(key, offset, elements);
+    }
+
+    // Merges every pending delta log into the file of its value. Returns the
+    // number of files rewritten.
+    size_t compact() {
+        std::unique_lock lock(m_mutex);
+        return compactImpl();
     }
 
     void fitSize() {
         std::unique_lock lock(m_mutex);
-        std::map<std::chrono::system_clock::time_point, Container::const_iterator> accessMap;
-        
-        for (auto it = m_container.cbegin(); it != m_container.cend(); ++it) {
-            if (isCashed(it->second)) {
-                accessMap[it->second.lastAccess] = it;
+        for (auto const& node: demoteCandidates()) {
+            auto const size = node->second.revision.dirty() ? payloadSize(node->second) : 0;
+            auto const serialized = serializedSize(node->second);
+            supersedeWrites(node->first);
+            auto path = writePath(node->first);
+            auto const written = storeValue(node->second, path, m_encoding);
+            m_serializedBytes -= serialized;
+            if (written) {
+                recordFile(node->first, node->second.lastAccess, size);
+                unshare(path);
             }
+            updateFootprint(node->second);
         }
+    }
+
+    // Evicts the same entries as fitSize, but serializes them under the lock and
+    // writes them as one batch through the disk engine. Entries stay resident
+    // until their write completes.
+    std::future<void> fitSizeAsync() {
+        auto [callback, future] = makeFutureCallback();
+        fitSizeImpl(std::move(callback));
+        return std::move(future);
+    }
+
+    // Writes every resident value to its file as one batch, values stay resident.
+    std::future<void> flush() {
+        auto [callback, future] = makeFutureCallback();
+        flushImpl(std::move(callback));
+        return std::move(future);
+    }
+
+    // Reloads evicted values in one batch of reads, so they are resident before
+    // the following load calls.
+    std::future<void> prefetch(std::vector<std::string> const& keys) {
+        auto [callback, future] = makeFutureCallback();
+        prefetchImpl(keys, std::move(callback));
+        return std::move(future);
+    }
+
+#if defined(BINARY_STORAGE_COROUTINES)
+    // Resident values complete without suspending, evicted ones resume the
+    // awaiting coroutine through the executor once the reload has finished.
+    Async<ValueType&> loadAsync(std::string const& key, Executor executor = {}) {
+        m_paramters.evictionPolicy->recordAccess(key);
+        std::string path;
+        {
+            std::unique_lock lock(m_mutex);
+            auto const iter = findNode(key);
+            if (iter == m_container.end() or isExpired(key)) {
+                throw std::logic_error("Key not found: " + key);
+            }
+
+            if (not std::holds_alternative<std::string>(iter->second.storage) or loadShared(iter->second)) {
+                auto& data = promote(iter->second);
+                applyDeltas(key, iter->second);
+                markModified(key, iter->second);
+                return Async<ValueType&>::ready(data);
+            }
+            path = std::get<std::string>(iter->second.storage);
+        }
+
+        auto state = std::make_shared<AsyncState<ValueType&>>(std::move(executor));
+        std::vector<DiskEngine::ReadRequest> reads;
+        reads.push_back({path, [this, state, key, path, generation = sharedGeneration()] (std::optional<std::string> bytes) {
+            auto const value = installLoaded(key, path, std::move(bytes), generation, true);
+            if (value == nullptr) {
+                state->setException(std::make_exception_ptr(std::logic_error("Can't load key: " + key)));
+            } else {
+                state->setValue(*value);
+            }
+        }});
+
+        engine().submit(std::move(reads));
+        return Async<ValueType&>(std::move(state));
+    }
 
-        auto const targetSize = accessMap.size() > m_paramters.cashSize 
-            ? accessMap.size() 
-            : static_cast<size_t>(accessMap.size() / m_paramters.resizeCoeff);
+    // Stores the value and writes it through to its file, the awaiting coroutine
+    // resumes once the write has completed.
+    Async<void> storeAsync(std::string const& key, ValueType&& value, Executor executor = {}) {
+        auto bytes = encodeValue(value, m_encoding);
+        auto const [stamp, revision] = storeImpl(key, std::forward<ValueType>(value));
 
-        while (targetSize != 0 and accessMap.size() > targetSize) {
-            auto const node = accessMap.extract(std::prev(accessMap.cend()));
-            auto path = m_paramters.path + node.mapped()->first + m_paramters.extension;
-            storeValue(node.mapped()->second, std::move(path));
+        auto state = std::make_shared<AsyncState<void>>(std::move(executor));
+        auto done = asyncCallback(state);
+        std::optional<uint64_t> sequence;
+        {
+            std::shared_lock lock(m_mutex);
+            auto const iter = m_container.find(key);
+            if (iter != m_container.end() and iter->second.lastAccess == stamp and iter->second.revision.current() == revision) {
+                sequence = beginWrite(key);
+            }
+        }
+        if (not sequence.has_value()) {
+            // Replaced or written out meanwhile, the newer state gets its own write.
+            done(true);
+            return Async<void>(std::move(state));
+        }
+
+        auto const size = bytes.size();
+        std::vector<DiskEngine::WriteRequest> writes;
+        writes.push_back(orderedWrite(key, writePath(key), std::move(bytes), *sequence, 
+            [this, key, stamp = stamp, revision = revision, size, done = std::move(done)] (bool ok) {
+                if (ok) {
+                    recordWritten(key, stamp, revision, size);
+                }
+                done(ok);
+            }));
+        engine().submit(std::move(writes));
+        return Async<void>(std::move(state));
+    }
+
+    Async<void> flushAsync(Executor executor = {}) {
+        auto state = std::make_shared<AsyncState<void>>(std::move(executor));
+        flushImpl(asyncCallback(state));
+        return Async<void>(std::move(state));
+    }
+#endif
+
+    Snapshot snapshot() {
+        return pin();
+    }
+
+    // Streams the values of a point-in-time snapshot into a single archive
+    // file while stores and erases go on. Returns the number of values written.
+    size_t snapshotToDisk(std::string const& path) {
+        return exportTo(path);
+    }
+
+    // Copies the whole storage into a single archive, see snapshotToDisk, with
+    // values in their encoded form so nothing is decoded. Together with
+    // importFrom it moves a storage as one sequential file instead of a file
+    // per key. Returns the number of values written.
+    size_t exportTo(std::string const& path) {
+        auto const view = snapshot();
+        auto const keys = view.keys();
+        archive::OutputFile stream(path);
+        archive::writeHeader(stream, keys.size(), archive::layoutOf<ValueType>(m_encoding));
+
+        for (auto const& key: keys) {
+            auto const payload = versionPayload(key, view.epoch());
+            if (not payload.has_value()) {
+                throw std::logic_error("Can't read key: " + key);
+            }
+
+            archive::writeEntry(stream, key, *payload);
         }
-    } 
+
+        archive::writeEnd(stream);
+        if (not stream.flush()) {
+            throw std::logic_error("Can't write archive: " + path);
+        }
+        return keys.size();
+    }
+
+    // Adds the values of an archive written by exportTo, replacing values with
+    // the same keys. The archive must hold values of this type in the
+    // encoding of this storage, else nothing is imported. The payloads go to
+    // the value files as they are and are decoded on first load. With threads
+    // above one the files of a batch are written concurrently and the
+    // container is sized for the archive up front. Returns the number of
+    // values imported.
+    size_t importFrom(std::string const& path, size_t threads = 1) {
+        archive::InputFile stream(path);
+        auto const header = stream.is_open() ? archive::readHeader(stream) : std::nullopt;
+        if (not header.has_value()) {
+            throw std::logic_error("Invalid archive: " + path);
+        }
+        if (header->layout != archive::layoutOf<ValueType>(m_encoding)) {
+            throw std::logic_error("Archive layout does not match the storage: " + path);
+        }
+
+        std::unique_ptr<ThreadPool> pool;
+        if (threads > 1) {
+            pool = std::make_unique<ThreadPool>(threads - 1);
+            std::unique_lock lock(m_mutex);
+            m_container.reserve(m_container.size() + header->entries);
+        }
+
+        size_t imported = 0;
+        size_t batchBytes = 0;
+        std::vector<std::pair<std::string, std::string>> batch;
+        auto const install = [&] {
+            importBatch(batch, pool.get());
+            imported += batch.size();
+            batch.clear();
+            batchBytes = 0;
+        };
+
+        while (auto entry = archive::readEntry(stream)) {
+            batchBytes += entry->second.size();
+            batch.push_back(std::move(*entry));
+            if (batchBytes >= archive::bufferSize or batch.size() >= importBatchSize) {
+                install();
+            }
+        }
+        install();
+        return imported;
+    }
 
     void clear() {
         std::unique_lock lock(m_mutex);
+        if (m_unloaded != 0) {
+            m_manifest->forEach([this] (Manifest::Entry const& entry) {
+                findNode(entry.key);
+            });
+        }
+
         while (not m_container.empty()) {
             eraseImpl(m_container.begin()->first);
         }
+        rebuildFilter();
     }
 
     size_t size() const noexcept {
         std::shared_lock lock(m_mutex);
-        return m_container.size();
+        return m_container.size() + m_unloaded;
+    }
+
+    // Memory used by values kept in the serialized tier.
+    size_t serializedBytes() const noexcept {
+        std::shared_lock lock(m_mutex);
+        return m_serializedBytes;
+    }
+
+    // Memory held by resident values as serde::memoryFootprint counts it. A
+    // value is measured when it is stored, loaded from disk or evicted, so
+    // changes made through a reference from load count from the next of these.
+    size_t residentBytes() const noexcept {
+        std::shared_lock lock(m_mutex);
+        return m_residentBytes;
     }
 
     void erase(std::string const& key)  {
@@ -93,19 +516,1257 @@ class Storage {
         eraseImpl(key);
     }
 
+    // Like load, but returns nullptr for a key that is not stored instead of
+    // throwing. Keys the key filter rules out are answered without taking
+    // the lock or touching the file system.
+    ValueType* tryLoad(std::string const& key) {
+        m_paramters.evictionPolicy->recordAccess(key);
+        return tryLoadImpl(key, true);
+    }
+
+    ValueType const* tryLoadConst(std::string const& key) {
+        m_paramters.evictionPolicy->recordAccess(key);
+        return tryLoadImpl(key, false);
+    }
+
+    bool contains(std::string const& key) const {
+        if (not mayContain(key)) {
+            return false;
+        }
+
+        std::shared_lock lock(m_mutex);
+        if (isExpired(key)) {
+            return false;
+        }
+        return m_container.count(key) != 0 or (m_unloaded != 0 and m_manifest->find(key).has_value());
+    }
+
+    // Erases the entries whose time to live has passed, in one batch under the
+    // lock taken from the timing wheel rather than a scan of the container.
+    // Their files are removed after the lock is released. Returns the number
+    // of erased entries.
+    size_t expire() {
+        std::vector<std::string> files;
+        size_t erased = 0;
+        {
+            std::unique_lock lock(m_mutex);
+            if (m_wheel.size() == 0) {
+                return 0;
+            }
+
+            for (auto const& timer: m_wheel.advance(currentTick())) {
+                auto const iter = m_expiry.find(timer.key);
+                if (iter != m_expiry.end() and iter->second == timer.deadline and eraseImpl(timer.key, &files)) {
+                    ++erased;
+                }
+            }
+        }
+
+        for (auto const& file: files) {
+            std::error_code error;
+            std::filesystem::remove(file, error);
+        }
+        return erased;
+    }
+
+    // Returns false when the key was not stored.
+    bool tryErase(std::string const& key) {
+        if (not mayContain(key)) {
+            return false;
+        }
+
+        std::unique_lock lock(m_mutex);
+        return eraseImpl(key);
+    }
+
    private:
+    // Previous version of a value, visible to the snapshots taken at an epoch
+    // after created and up to replaced.
+    struct Version {
+        uint64_t created;
+        uint64_t replaced;
+        Value<ValueType> value;
+    };
+
+    // Delta log of an evicted vector, length is the one of the vector with
+    // the deltas applied.
+    struct PendingDeltas {
+        size_t length;
+        size_t bytes;
+        size_t fileBytes;
+    };
+
+    // Disk engine writes of a key that have not completed yet, and the
+    // sequence of the last write that reached its file.
+    struct FileWrites {
+        size_t inFlight {0};
+        uint64_t landed {0};
+    };
+
     mutable std::shared_mutex m_mutex;
     BaseParameters m_paramters;
+    Encoding m_encoding;
     Container m_container; 
+    size_t m_serializedBytes {0};
+    size_t m_residentBytes {0};
+    std::unique_ptr<Manifest> m_manifest;
+    size_t m_unloaded {0};
+    std::once_flag m_engineFlag;
+    std::unique_ptr<DiskEngine> m_engine;
+    std::unique_ptr<ReadIndex<ValueType>> m_readIndex;
+    std::unique_ptr<SharedSegment> m_shared;
+    std::unique_ptr<ThreadPool> m_serdePool;
+    std::unique_ptr<std::atomic<bool>[]> m_directories;
+    mutable std::atomic<KeyFilter*> m_filter {nullptr};
+    mutable std::shared_ptr<KeyFilter> m_filterOwner;
+    mutable size_t m_filterChanges {0};
+    mutable EpochDomain m_filterDomain;
+    std::chrono::steady_clock::time_point m_ttlOrigin {std::chrono::steady_clock::now()};
+    std::unordered_map<std::string, uint64_t> m_expiry;
+    TimingWheel m_wheel;
+    uint64_t m_epoch {0};
+    std::multiset<uint64_t> m_pinned;
+    std::unordered_map<std::string, std::vector<Version>> m_versions;
+    std::unordered_map<std::string, PendingDeltas> m_deltas;
+    std::mutex m_writesMutex;
+    uint64_t m_writeSequence {0};
+    std::unordered_map<std::string, FileWrites> m_fileWrites;
 
    private: 
-    void eraseImpl(std::string const& key) {
-        auto const node = m_container.extract(key);
-        std::filesystem::directory_iterator file(m_paramters.path + node.key());
-        if (file->exists()) {
-            std::filesystem::remove(file->path());
+    // Erases the entry and its file, or hands the file path over in files to
+    // be removed once the lock is released.
+    bool eraseImpl(std::string const& key, std::vector<std::string>* files = nullptr) {
+        auto const iter = findNode(key);
+        if (iter == m_container.end()) {
+            return false;
+        }
+
+        m_serializedBytes -= serializedSize(iter->second);
+        m_residentBytes -= iter->second.footprint;
+        preserveVersion(key, iter->second, false);
+        unpublish(key);
+        auto const node = m_container.extract(iter);
+        if (m_manifest != nullptr) {
+            m_manifest->erase(key);
+        }
+
+        if (not m_expiry.empty()) {
+            m_expiry.erase(key);
+        }
+
+        if (files != nullptr) {
+            files->push_back(filePath(node.key()));
+        } else {
+            std::error_code error;
+            std::filesystem::remove(filePath(node.key()), error);
+        }
+        dropDeltas(key, files);
+        supersedeWrites(key);
+        updateFilter(key, false);
+        return true;
+    }
+
+    // Whether files are named after the encoded key rather than the key itself.
+    bool encodedNames() const noexcept {
+        return m_paramters.encodeKeys or m_paramters.fanOutLevels != 0;
+    }
+
+    // Longest suffix added to the name of a key's file: a dot, a 20 digit
+    // write sequence and ".tmp". Snapshot, delta and import files add less.
+    static constexpr size_t nameSuffix {25};
+
+    // Throws unless every file of the key gets a name within maxFileName.
+    // Snapshot and delta files use the encoded key in every layout.
+    void checkKey(std::string const& key) const {
+        encodeKey(key, m_paramters.extension.size() + nameSuffix);
+    }
+
+    // Path of the key's file relative to the storage directory, as kept in the
+    // manifest.
+    std::string location(std::string const& key) const {
+        if (not encodedNames()) {
+            return key + m_paramters.extension;
+        }
+        return fanOutDirectory(key, m_paramters.fanOutLevels) + encodeKey(key) + m_paramters.extension;
+    }
+
+    std::string filePath(std::string const& key) const {
+        return m_paramters.path + location(key);
+    }
+
+    // Path for writing the key's file, its fan-out directory is created once.
+    std::string writePath(std::string const& key) {
+        if (m_paramters.fanOutLevels != 0) {
+            auto& created = m_directories[fanOutBucket(key, m_paramters.fanOutLevels)];
+            if (not created.load(std::memory_order_acquire)) {
+                std::filesystem::create_directories(m_paramters.path + fanOutDirectory(key, m_paramters.fanOutLevels));
+                created.store(true, std::memory_order_release);
+            }
+        }
+        return filePath(key);
+    }
+
+    // Finds the entry, bringing keys that are only known to the manifest into
+    // the container as evicted values. Requires the exclusive lock.
+    typename Container::iterator findNode(std::string const& key) {
+        auto const iter = m_container.find(key);
+        if (iter != m_container.end() or m_unloaded == 0) {
+            return iter;
+        }
+
+        auto const entry = m_manifest->find(key);
+        if (not entry.has_value()) {
+            return iter;
+        }
+
+        --m_unloaded;
+        return m_container.emplace(key, Value<ValueType> {m_paramters.path + entry->location, entry->lastAccess, false, 0, 0, 0}).first;
+    }
+
+    // Journals a value file that has just been written. Requires the exclusive lock.
+    void recordFile(std::string const& key, std::chrono::system_clock::time_point lastAccess, size_t size) {
+        if (m_manifest == nullptr) {
+            return;
+        }
+
+        m_manifest->put({key, location(key), size, lastAccess});
+        if (m_manifest->journalSize() >= m_paramters.manifestCheckpointInterval) {
+            m_manifest->checkpoint();
+        }
+    }
+
+    // Handles a write of the given revision that completed on the disk engine:
+    // the value is clean unless it was modified or replaced meanwhile.
+    void recordWritten(std::string const& key, 
+                       std::chrono::system_clock::time_point stamp, 
+                       uint64_t revision, 
+                       size_t size) {
+        std::unique_lock lock(m_mutex);
+        auto const iter = m_container.find(key);
+        if (iter == m_container.end()) {
+            return;
+        }
+
+        if (iter->second.lastAccess == stamp) {
+            iter->second.revision.markWritten(revision);
+        }
+        recordFile(key, iter->second.lastAccess, size);
+    }
+
+    // Numbers a disk engine write of the key, must be called under the lock
+    // the written data was taken under.
+    uint64_t beginWrite(std::string const& key) {
+        std::lock_guard lock(m_writesMutex);
+        ++m_fileWrites[key].inFlight;
+        return ++m_writeSequence;
+    }
+
+    // Disk engine writes go to a temporary file that replaces the key's file
+    // once complete, unless a later write of the key got there first, so a
+    // slow write of older data never overwrites newer data.
+    DiskEngine::WriteRequest orderedWrite(std::string const& key, 
+                                          std::string path, 
+                                          std::string data, 
+                                          uint64_t sequence, 
+                                          DiskEngine::WriteCallback done) {
+        auto temporary = path + '.' + std::to_string(sequence) + ".tmp";
+        auto callback = [this, key, path = std::move(path), temporary, sequence, done = std::move(done)] (bool ok) {
+            {
+                std::lock_guard lock(m_writesMutex);
+                auto const writes = m_fileWrites.find(key);
+                std::error_code error;
+                if (ok and sequence > writes->second.landed) {
+                    std::filesystem::rename(temporary, path, error);
+                    ok = not error;
+                    if (ok) {
+                        unshare(path);
+                    }
+                    writes->second.landed = ok ? sequence : writes->second.landed;
+                }
+                if (not ok or writes->second.landed != sequence) {
+                    std::filesystem::remove(temporary, error);
+                }
+                if (--writes->second.inFlight == 0) {
+                    m_fileWrites.erase(writes);
+                }
+            }
+            done(ok);
+        };
+        return {std::move(temporary), std::move(data), std::move(callback)};
+    }
+
+    // Called before the key's file is written or removed directly, so engine
+    // writes still in flight for it are dropped. Requires the exclusive lock.
+    void supersedeWrites(std::string const& key) {
+        std::lock_guard lock(m_writesMutex);
+        if (auto const writes = m_fileWrites.find(key); writes != m_fileWrites.end()) {
+            writes->second.landed = ++m_writeSequence;
+        }
+    }
+
+    std::pair<std::chrono::system_clock::time_point, uint64_t> storeImpl(std::string const& key, 
+                                                                         ValueType&& value, 
+                                                                         std::chrono::milliseconds ttl = {}) {
+        checkKey(key);
+        m_paramters.evictionPolicy->recordAccess(key);
+        std::unique_lock lock(m_mutex);
+        auto iter = findNode(key);
+        if (iter == m_container.end()) {
+            iter = m_container.try_emplace(key).first;
+            updateFilter(key, true);
+        } else {
+            m_serializedBytes -= serializedSize(iter->second);
+            m_residentBytes -= iter->second.footprint;
+            preserveVersion(key, iter->second, false);
+            unpublish(key);
+            dropDeltas(key);
+        }
+
+        iter->second = createFromData(std::forward<ValueType>(value));
+        iter->second.epoch = m_epoch;
+        updateFootprint(iter->second);
+        setExpiry(key, ttl);
+        return {iter->second.lastAccess, iter->second.revision.current()};
+    }
+
+    // Brings the resident total in line with the value after it was made
+    // resident, changed or evicted, and keeps the serialized size the
+    // eviction policy weighs it by. Requires the exclusive lock.
+    void updateFootprint(Value<ValueType>& value) noexcept {
+        auto const cashed = isCashed(value);
+        auto const footprint = cashed ? serde::memoryFootprint(std::get<ValueType>(value.storage)) : 0;
+        m_residentBytes = m_residentBytes - value.footprint + footprint;
+        value.footprint = footprint;
+        value.bytes = cashed ? serde::serializedSize(std::get<ValueType>(value.storage)) : 0;
+    }
+
+    uint64_t currentTick() const noexcept {
+        auto const elapsed = std::chrono::steady_clock::now() - m_ttlOrigin;
+        return static_cast<uint64_t>(elapsed / std::max(m_paramters.ttlResolution, std::chrono::milliseconds {1}));
+    }
+
+    // Requires the exclusive lock.
+    void setExpiry(std::string const& key, std::chrono::milliseconds ttl) {
+        if (ttl <= std::chrono::milliseconds::zero()) {
+            if (not m_expiry.empty()) {
+                m_expiry.erase(key);
+            }
+            return;
+        }
+
+        auto const resolution = std::max(m_paramters.ttlResolution, std::chrono::milliseconds {1});
+        auto const deadline = currentTick() + static_cast<uint64_t>((ttl + resolution - std::chrono::milliseconds {1}) / resolution);
+        m_expiry.insert_or_assign(key, deadline);
+        m_wheel.schedule(key, deadline);
+    }
+
+    // Requires a lock.
+    bool isExpired(std::string const& key) const noexcept {
+        if (m_expiry.empty()) {
+            return false;
+        }
+
+        auto const iter = m_expiry.find(key);
+        return iter != m_expiry.end() and iter->second <= currentTick();
+    }
+
+    ValueType& loadImpl(std::string const& key, bool modify) {
+        auto const value = tryLoadImpl(key, modify);
+        if (value == nullptr) {
+            throw std::logic_error("Key not found: " + key);
+        }
+        return *value;
+    }
+
+    ValueType* tryLoadImpl(std::string const& key, bool modify) {
+        if (not mayContain(key)) {
+            return nullptr;
         }
-    } 
+
+        {
+            std::shared_lock lock(m_mutex);
+            auto const iter = m_container.find(key);
+            if (iter == m_container.end()) {
+                if (m_unloaded == 0) {
+                    return nullptr;
+                }
+            } else if (isExpired(key)) {
+                return nullptr;
+            } else if (isCashed(iter->second) and not (modify and needsVersion(iter->second))) {
+                if (modify) {
+                    iter->second.revision.lend();
+                    unpublish(key);
+                }
+                return &std::get<ValueType>(iter->second.storage);
+            }
+        }
+
+        std::unique_lock lock(m_mutex);
+        auto const iter = findNode(key);
+        if (iter == m_container.end() or isExpired(key)) {
+            return nullptr;
+        }
+
+        auto& data = promote(iter->second);
+        applyDeltas(key, iter->second);
+        if (modify) {
+            markModified(key, iter->second);
+        }
+        return &data;
+    }
+
+    // False only for keys that are not stored, checked without any lock once
+    // the filter exists. With a manifest it is built by the first lookup, as
+    // building it at startup would visit every manifest entry.
+    bool mayContain(std::string const& key) const {
+        if (m_paramters.keyFilterBits == 0) {
+            return true;
+        }
+
+        if (m_filter.load() == nullptr) {
+            std::unique_lock lock(m_mutex);
+            if (m_filter.load() == nullptr) {
+                rebuildFilter();
+            }
+        }
+
+        auto const guard = m_filterDomain.enter();
+        return m_filter.load()->mayContain(key);
+    }
+
+    // Records a key that became known, or one that was erased and keeps its
+    // bits, rebuilding the filter once it holds more keys than it was sized
+    // for. Requires the exclusive lock.
+    void updateFilter(std::string const& key, bool added) {
+        if (m_paramters.keyFilterBits == 0 or m_filterOwner == nullptr) {
+            return;
+        }
+
+        if (added) {
+            m_filterOwner->add(key);
+        }
+        if (++m_filterChanges > m_filterOwner->capacity()) {
+            rebuildFilter();
+        }
+    }
+
+    // Requires the exclusive lock.
+    void rebuildFilter() const {
+        if (m_paramters.keyFilterBits == 0) {
+            return;
+        }
+
+        auto const keys = m_container.size() + m_unloaded;
+        auto filter = std::make_shared<KeyFilter>(keys * 2, m_paramters.keyFilterBits);
+        for (auto const& node: m_container) {
+            filter->add(node.first);
+        }
+        if (m_unloaded != 0) {
+            m_manifest->forEach([&filter] (Manifest::Entry const& entry) {
+                filter->add(entry.key);
+            });
+        }
+
+        m_filter.store(filter.get());
+        if (m_filterOwner != nullptr) {
+            m_filterDomain.retire(std::move(m_filterOwner));
+        }
+        m_filterOwner = std::move(filter);
+        m_filterChanges = keys;
+    }
+
+    // Marks a resident value as handed out for modification, keeping a copy of
+    // the current version when a snapshot can see it. Requires the exclusive lock.
+    void markModified(std::string const& key, Value<ValueType>& value) {
+        preserveVersion(key, value, true);
+        value.revision.lend();
+        unpublish(key);
+    }
+
+    // Drops the copy read() published for the key. Touching the revision first
+    // keeps a concurrent miss from publishing the old value again.
+    void unpublish(std::string const& key) {
+        if (m_readIndex != nullptr) {
+            m_readIndex->unpublish(key);
+        }
+    }
+
+    bool needsVersion(Value<ValueType> const& value) const noexcept {
+        return not m_pinned.empty() and *m_pinned.rbegin() > value.epoch;
+    }
+
+    std::string versionPath(std::string const& key, uint64_t epoch) const {
+        return m_paramters.path + "snapshots/" + encodeKey(key) + '.' + std::to_string(epoch) + m_paramters.extension;
+    }
+
+    std::string deltaPath(std::string const& key) const {
+        return m_paramters.path + "deltas/" + encodeKey(key) + ".delta";
+    }
+
+    // Element count of a vector file, read from its first field in every encoding.
+    size_t storedLength(std::string const& path) const {
+        std::ifstream stream(path, std::ios::binary);
+        auto const length = serde::deserialize<typename ValueType::size_type>(stream);
+        if (not length.has_value()) {
+            throw std::logic_error("Can't read file: " + path);
+        }
+        return *length;
+    }
+
+    static size_t fileSize(std::string const& path) noexcept {
+        std::error_code error;
+        auto const size = std::filesystem::file_size(path, error);
+        return error ? 0 : static_cast<size_t>(size);
+    }
+
+    // Resident values are changed in place, evicted ones get a record in their
+    // delta log unless a snapshot still sees them. Offset is std::nullopt for
+    // appends.
+    size_t updateVector(std::string const& key, std::optional<size_t> offset, ValueType const& elements) {
+        m_paramters.evictionPolicy->recordAccess(key);
+        std::unique_lock lock(m_mutex);
+        auto const iter = findNode(key);
+        if (iter == m_container.end() or isExpired(key)) {
+            throw std::logic_error("Key not found: " + key);
+        }
+
+        auto const checkRange = [&] (size_t length) {
+            if (offset.has_value() and (*offset > length or elements.size() > length - *offset)) {
+                throw std::logic_error("Patch out of range: " + key);
+            }
+        };
+
+        auto& value = iter->second;
+        auto const file = std::get_if<std::string>(&value.storage);
+        if (file == nullptr or needsVersion(value)) {
+            auto& data = promote(value);
+            applyDeltas(key, value);
+            checkRange(data.size());
+            preserveVersion(key, value, true);
+            value.revision.touch();
+            unpublish(key);
+            if (offset.has_value()) {
+                std::copy(elements.begin(), elements.end(), data.begin() + static_cast<std::ptrdiff_t>(*offset));
+            } else {
+                data.insert(data.end(), elements.begin(), elements.end());
+            }
+            updateFootprint(value);
+            return data.size();
+        }
+
+        auto pending = m_deltas.find(key);
+        if (pending == m_deltas.end()) {
+            std::filesystem::create_directories(m_paramters.path + "deltas/");
+            pending = m_deltas.emplace(key, PendingDeltas {storedLength(*file), 0, fileSize(*file)}).first;
+        }
+        checkRange(pending->second.length);
+
+        std::ofstream stream(deltaPath(key), std::ios::binary | std::ios::app);
+        if (offset.has_value()) {
+            delta::writePatch(stream, *offset, elements);
+        } else {
+            delta::writeAppend(stream, elements);
+        }
+        if (not stream.flush()) {
+            stream.close();
+            std::error_code error;
+            std::filesystem::resize_file(deltaPath(key), pending->second.bytes, error);
+            throw std::logic_error("Can't write delta log: " + key);
+        }
+        stream.close();
+
+        if (offset.has_value()) {
+            pending->second.bytes += delta::patchSize(elements);
+        } else {
+            pending->second.bytes += delta::appendSize(elements);
+            pending->second.length += elements.size();
+        }
+
+        auto const length = pending->second.length;
+        if (pending->second.bytes > pending->second.fileBytes) {
+            compactValue(key, value);
+        }
+        return length;
+    }
+
+    // Applies the pending deltas of a value that was just made resident, it
+    // stays modified until written. Requires the exclusive lock.
+    void applyDeltas(std::string const& key, Value<ValueType>& value) {
+        if constexpr (serde::isContiguous<ValueType>) {
+            auto const pending = m_deltas.empty() ? m_deltas.end() : m_deltas.find(key);
+            if (pending == m_deltas.end()) {
+                return;
+            }
+
+            std::ifstream stream(deltaPath(key), std::ios::binary);
+            if (not delta::apply(stream, std::get<ValueType>(value.storage))) {
+                value.storage = filePath(key);
+                throw std::logic_error("Invalid delta log: " + key);
+            }
+            stream.close();
+
+            value.revision.touch();
+            updateFootprint(value);
+            m_deltas.erase(pending);
+            std::error_code error;
+            std::filesystem::remove(deltaPath(key), error);
+        }
+    }
+
+    // Rewrites the file of an evicted value with its deltas applied.
+    void compactValue(std::string const& key, Value<ValueType>& value) {
+        promote(value);
+        applyDeltas(key, value);
+        auto const size = payloadSize(value);
+        supersedeWrites(key);
+        auto path = writePath(key);
+        if (storeValue(value, path, m_encoding)) {
+            recordFile(key, value.lastAccess, size);
+            unshare(path);
+        }
+        updateFootprint(value);
+    }
+
+    // Requires the exclusive lock.
+    size_t compactImpl() {
+        std::vector<std::string> keys;
+        for (auto const& pending: m_deltas) {
+            keys.push_back(pending.first);
+        }
+
+        for (auto const& key: keys) {
+            compactValue(key, m_container.find(key)->second);
+        }
+        return keys.size();
+    }
+
+    void dropDeltas(std::string const& key, std::vector<std::string>* files = nullptr) {
+        if (m_deltas.empty() or m_deltas.erase(key) == 0) {
+            return;
+        }
+
+        if (files != nullptr) {
+            files->push_back(deltaPath(key));
+        } else {
+            std::error_code error;
+            std::filesystem::remove(deltaPath(key), error);
+        }
+    }
+
+    // Picks up the delta logs left by a previous run. Logs of keys that are not
+    // stored, or whose value is not in its file, are dropped. A record torn by
+    // a crash is cut off, so new records do not land behind it.
+    void loadDeltas() {
+        namespace fs = std::filesystem;
+        auto const directory = m_paramters.path + "deltas/";
+        if (not fs::exists(directory)) {
+            return;
+        }
+
+        for (auto const& entry: fs::directory_iterator(directory)) {
+            std::optional<delta::Extent> extent;
+            auto const key = entry.path().extension() == ".delta" ? decodeKey(entry.path().stem().string()) : std::nullopt;
+            auto const iter = key.has_value() ? findNode(*key) : m_container.end();
+            if constexpr (serde::isContiguous<ValueType>) {
+                if (iter != m_container.end() and std::holds_alternative<std::string>(iter->second.storage)) {
+                    std::ifstream stream(entry.path(), std::ios::binary);
+                    extent = delta::extent<ValueType>(stream, storedLength(std::get<std::string>(iter->second.storage)));
+                }
+            }
+
+            if (extent.has_value() and extent->bytes != 0) {
+                if (extent->bytes != entry.file_size()) {
+                    fs::resize_file(entry.path(), extent->bytes);
+                }
+                auto const& file = std::get<std::string>(iter->second.storage);
+                m_deltas.emplace(*key, PendingDeltas {extent->length, extent->bytes, fileSize(file)});
+            } else {
+                std::error_code error;
+                fs::remove(entry.path(), error);
+            }
+        }
+    }
+
+    static constexpr size_t importBatchSize {1024};
+
+    // Writes the files of imported entries and points their values at them.
+    // The payloads go to temporary files first, the entries are only changed
+    // once every write has succeeded, replaced values are then kept for
+    // snapshots before the temporary files take the place of their files.
+    void importBatch(std::vector<std::pair<std::string, std::string>> const& batch, ThreadPool* pool) {
+        if (batch.empty()) {
+            return;
+        }
+        for (auto const& entry: batch) {
+            checkKey(entry.first);
+        }
+
+        std::unique_lock lock(m_mutex);
+        std::vector<std::string> paths(batch.size());
+        std::atomic<bool> failed {false};
+        auto const write = [&] (size_t i) {
+            paths[i] = writePath(batch[i].first);
+            if (not writeFile(paths[i] + ".import", batch[i].second)) {
+                failed = true;
+            }
+        };
+        if (pool != nullptr) {
+            pool->parallelFor(batch.size(), write);
+        } else {
+            for (size_t i = 0; i < batch.size(); ++i) {
+                write(i);
+            }
+        }
+        if (failed) {
+            for (auto const& path: paths) {
+                std::error_code error;
+                std::filesystem::remove(path + ".import", error);
+            }
+            throw std::logic_error("Can't write imported values: " + m_paramters.path);
+        }
+
+        for (size_t i = 0; i < batch.size(); ++i) {
+            auto const& key = batch[i].first;
+            auto iter = findNode(key);
+            if (iter == m_container.end()) {
+                iter = m_container.try_emplace(key).first;
+                updateFilter(key, true);
+            } else {
+                m_serializedBytes -= serializedSize(iter->second);
+                m_residentBytes -= iter->second.footprint;
+                preserveVersion(key, iter->second, false);
+                unpublish(key);
+                dropDeltas(key);
+            }
+            supersedeWrites(key);
+            std::filesystem::rename(paths[i] + ".import", paths[i]);
+            unshare(paths[i]);
+
+            iter->second = createFormFile<ValueType>(std::move(paths[i]));
+            iter->second.epoch = m_epoch;
+            setExpiry(key, {});
+            recordFile(key, iter->second.lastAccess, batch[i].second.size());
+        }
+    }
+
+    // Keeps the current version of the value for the pinned snapshots that can
+    // see it, before it is replaced, erased or modified in place. The data is
+    // moved, or copied when the value stays current, evicted values keep their
+    // file, which is moved aside. Requires the exclusive lock.
+    void preserveVersion(std::string const& key, Value<ValueType>& value, bool keepCurrent) {
+        if (not needsVersion(value)) {
+            return;
+        }
+
+        Version version {value.epoch, m_epoch, {std::string {}, value.lastAccess, false, value.epoch, 0, 0}};
+        if (auto const file = std::get_if<std::string>(&value.storage); file != nullptr) {
+            auto path = versionPath(key, value.epoch);
+            std::filesystem::create_directories(m_paramters.path + "snapshots/");
+            std::filesystem::rename(*file, path);
+            version.value.storage = std::move(path);
+            if (m_manifest != nullptr) {
+                m_manifest->erase(key);
+            }
+        } else if (keepCurrent) {
+            version.value.storage = value.storage;
+        } else {
+            version.value.storage = std::move(value.storage);
+        }
+
+        m_versions[key].push_back(std::move(version));
+        value.epoch = m_epoch;
+    }
+
+    // Pending deltas are merged first, the values of a snapshot are read from
+    // their files as they are.
+    Snapshot pin() {
+        std::unique_lock lock(m_mutex);
+        compactImpl();
+        auto const epoch = ++m_epoch;
+        m_pinned.insert(epoch);
+        return Snapshot(this, epoch);
+    }
+
+    // Unpins a snapshot and drops the versions no remaining snapshot can see.
+    void release(uint64_t epoch) noexcept {
+        std::unique_lock lock(m_mutex);
+        m_pinned.erase(m_pinned.find(epoch));
+        auto const oldest = m_pinned.empty() ? std::numeric_limits<uint64_t>::max() : *m_pinned.begin();
+
+        for (auto it = m_versions.begin(); it != m_versions.end();) {
+            auto& versions = it->second;
+            versions.erase(std::remove_if(versions.begin(), versions.end(), [oldest] (Version const& version) {
+                if (version.replaced >= oldest) {
+                    return false;
+                }
+
+                if (auto const file = std::get_if<std::string>(&version.value.storage); file != nullptr) {
+                    std::error_code error;
+                    std::filesystem::remove(*file, error);
+                }
+                return true;
+            }), versions.end());
+            it = versions.empty() ? m_versions.erase(it) : std::next(it);
+        }
+    }
+
+    // Calls visit with the version of the key visible at the epoch. Requires a lock.
+    template<class F>
+    bool visitVersion(std::string const& key, uint64_t epoch, F&& visit) const {
+        if (auto const versions = m_versions.find(key); versions != m_versions.end()) {
+            for (auto const& version: versions->second) {
+                if (version.created < epoch and epoch <= version.replaced) {
+                    visit(version.value);
+                    return true;
+                }
+            }
+        }
+
+        if (auto const iter = m_container.find(key); iter != m_container.end()) {
+            if (iter->second.epoch >= epoch) {
+                return false;
+            }
+            visit(iter->second);
+            return true;
+        }
+
+        if (auto const entry = m_unloaded == 0 ? std::nullopt : m_manifest->find(key); entry.has_value()) {
+            visit(Value<ValueType> {m_paramters.path + entry->location, entry->lastAccess, false, 0, 0, 0});
+            return true;
+        }
+        return false;
+    }
+
+    std::vector<std::string> versionKeys(uint64_t epoch) const {
+        std::set<std::string> keys;
+        std::shared_lock lock(m_mutex);
+        for (auto const& [key, value]: m_container) {
+            if (value.epoch < epoch) {
+                keys.insert(key);
+            }
+        }
+
+        for (auto const& [key, versions]: m_versions) {
+            for (auto const& version: versions) {
+                if (version.created < epoch and epoch <= version.replaced) {
+                    keys.insert(key);
+                }
+            }
+        }
+
+        if (m_unloaded != 0) {
+            m_manifest->forEach([&] (Manifest::Entry const& entry) {
+                if (m_container.count(entry.key) == 0) {
+                    keys.insert(entry.key);
+                }
+            });
+        }
+        return {keys.begin(), keys.end()};
+    }
+
+    std::optional<ValueType> versionData(std::string const& key, uint64_t epoch) const {
+        std::optional<ValueType> result;
+        std::shared_lock lock(m_mutex);
+        auto const found = visitVersion(key, epoch, [&] (Value<ValueType> const& value) {
+            result = readData(value, m_encoding);
+            if (not result.has_value()) {
+                throw std::logic_error("Deserialize error: " + key);
+            }
+        });
+        return found ? std::move(result) : std::nullopt;
+    }
+
+    std::optional<std::string> versionPayload(std::string const& key, uint64_t epoch) const {
+        std::optional<std::string> result;
+        std::shared_lock lock(m_mutex);
+        visitVersion(key, epoch, [&] (Value<ValueType> const& value) {
+            if (auto const data = std::get_if<ValueType>(&value.storage); data != nullptr) {
+                result = encodeValue(*data, m_encoding);
+            } else if (auto const serialized = std::get_if<SerializedValue>(&value.storage); serialized != nullptr) {
+                result = serializedPayload(*serialized);
+            } else {
+                result = readFile(std::get<std::string>(value.storage));
+            }
+        });
+        return result;
+    }
+
+    // Runs a partial read of the value under the shared lock, keys only known
+    // to the manifest are read from their file without being brought in.
+    // Values with pending deltas are loaded to merge them first, the read then
+    // runs under the exclusive lock so no new delta can slip in between.
+    template<class F>
+    auto readShared(std::string const& key, F&& read) {
+        m_paramters.evictionPolicy->recordAccess(key);
+        std::shared_lock lock(m_mutex);
+        if (m_deltas.empty() or m_deltas.count(key) == 0) {
+            return readLocked(key, read);
+        }
+
+        lock.unlock();
+        std::unique_lock exclusive(m_mutex);
+        auto const iter = m_container.find(key);
+        if (iter != m_container.end() and not isExpired(key) and m_deltas.count(key) != 0) {
+            promote(iter->second);
+            applyDeltas(key, iter->second);
+        }
+        return readLocked(key, read);
+    }
+
+    // Requires a lock.
+    template<class F>
+    auto readLocked(std::string const& key, F&& read) {
+        if (isExpired(key)) {
+            throw std::logic_error("Key not found: " + key);
+        }
+
+        decltype(read(std::declval<Value<ValueType> const&>(), m_encoding)) result;
+        auto const iter = m_container.find(key);
+        if (iter != m_container.end()) {
+            result = read(iter->second, m_encoding);
+        } else if (auto const entry = m_unloaded == 0 ? std::nullopt : m_manifest->find(key); entry.has_value()) {
+            result = read(Value<ValueType> {m_paramters.path + entry->location, entry->lastAccess, false, 0, 0, 0}, m_encoding);
+        } else {
+            throw std::logic_error("Key not found: " + key);
+        }
+
+        if (not result.has_value()) {
+            throw std::logic_error("Deserialize error: " + key);
+        }
+        return std::move(*result);
+    }
+
+    size_t payloadSize(Value<ValueType> const& value) const noexcept {
+        if (auto const serialized = std::get_if<SerializedValue>(&value.storage); serialized != nullptr) {
+            return serialized->size;
+        }
+        if (auto const data = std::get_if<ValueType>(&value.storage); data != nullptr) {
+            return encodedSize(*data, m_encoding);
+        }
+        return 0;
+    }
+
+    DiskEngine& engine() {
+        std::call_once(m_engineFlag, [this] {
+            m_engine = makeDiskEngine(m_paramters.diskEngine, m_paramters.ioThreads, m_paramters.ioQueueDepth);
+        });
+        return *m_engine;
+    }
+
+    // Resident entries the eviction policy picks once there are more than
+    // cashSize of them or they take more than cashBytes serialized, the
+    // resident set then shrinks to both limits divided by resizeCoeff.
+    std::vector<typename Container::iterator> evictionCandidates() {
+        std::vector<typename Container::iterator> resident;
+        std::vector<EvictionPolicy::Candidate> candidates;
+        size_t bytes = 0;
+        for (auto it = m_container.begin(); it != m_container.end(); ++it) {
+            if (isCashed(it->second)) {
+                bytes += it->second.bytes;
+                resident.push_back(it);
+                candidates.push_back({&it->first, it->second.lastAccess, it->second.bytes});
+            }
+        }
+
+        std::vector<typename Container::iterator> victims;
+        if (resident.size() <= m_paramters.cashSize and (m_paramters.cashBytes == 0 or bytes <= m_paramters.cashBytes)) {
+            return victims;
+        }
+
+        EvictionPolicy::Budget const budget {static_cast<size_t>(m_paramters.cashSize / m_paramters.resizeCoeff),
+                                             static_cast<size_t>(m_paramters.cashBytes / m_paramters.resizeCoeff)};
+        for (auto const index: m_paramters.evictionPolicy->selectVictims(candidates, budget)) {
+            victims.push_back(resident[index]);
+            unpublish(resident[index]->first);
+        }
+        return victims;
+    }
+
+    // Moves eviction candidates into the serialized tier when it is enabled and
+    // returns the entries that have to be written to disk: the candidates
+    // themselves without a tier, otherwise the oldest tier entries beyond its budget.
+    std::vector<typename Container::iterator> demoteCandidates() {
+        auto candidates = evictionCandidates();
+        if (m_paramters.serializedCacheSize == 0) {
+            return candidates;
+        }
+
+        for (auto const& node: candidates) {
+            m_serializedBytes += demoteValue(node->second, m_paramters.compressSerialized, m_encoding);
+            updateFootprint(node->second);
+        }
+
+        std::multimap<std::chrono::system_clock::time_point, typename Container::iterator> accessMap;
+        for (auto it = m_container.begin(); it != m_container.end(); ++it) {
+            if (isSerialized(it->second)) {
+                accessMap.emplace(it->second.lastAccess, it);
+            }
+        }
+
+        candidates.clear();
+        auto bytes = m_serializedBytes;
+        for (auto it = accessMap.begin(); it != accessMap.end() and bytes > m_paramters.serializedCacheSize; ++it) {
+            bytes -= serializedSize(it->second->second);
+            candidates.push_back(it->second);
+        }
+        return candidates;
+    }
+
+    ValueType& promote(Value<ValueType>& value) {
+        if (isSerialized(value)) {
+            m_serializedBytes -= serializedSize(value);
+            value.lastAccess = std::chrono::system_clock::now();
+        } else if (m_shared != nullptr and not isCashed(value) and not loadShared(value)) {
+            auto const& path = std::get<std::string>(value.storage);
+            auto const generation = m_shared->generation();
+            auto bytes = readFile(path);
+            if (not bytes.has_value()) {
+                throw std::logic_error("Can't read file: " + path);
+            }
+
+            share(path, *bytes, generation);
+            auto data = decodeValue<ValueType>(std::move(*bytes), m_encoding);
+            if (not data.has_value()) {
+                throw std::logic_error("Deserialize eror");
+            }
+            value.storage = std::move(*data);
+        }
+
+        auto& data = getData(value, m_encoding);
+        updateFootprint(value);
+        return data;
+    }
+
+    // Makes an evicted value resident from the shared memory segment, returns
+    // false when the segment holds no copy of its current file.
+    bool loadShared(Value<ValueType>& value) {
+        if (m_shared == nullptr) {
+            return false;
+        }
+
+        auto const& path = std::get<std::string>(value.storage);
+        auto const stamp = SharedSegment::fileStamp(path);
+        auto bytes = stamp.has_value() ? m_shared->get(path, *stamp) : std::nullopt;
+        if (not bytes.has_value()) {
+            return false;
+        }
+
+        auto data = decodeValue<ValueType>(std::move(*bytes), m_encoding);
+        if (not data.has_value()) {
+            return false;
+        }
+        value.storage = std::move(*data);
+        return true;
+    }
+
+    // Offers the contents of a file read from disk to the other processes,
+    // generation is the one of the segment before the file was read.
+    void share(std::string const& path, std::string const& bytes, uint64_t generation) {
+        if (m_shared == nullptr) {
+            return;
+        }
+
+        if (auto const stamp = SharedSegment::fileStamp(path); stamp.has_value()) {
+            m_shared->put(path, *stamp, bytes, generation);
+        }
+    }
+
+    // Drops the shared copy of a file this storage has rewritten.
+    void unshare(std::string const& path) {
+        if (m_shared != nullptr) {
+            m_shared->erase(path);
+        }
+    }
+
+    uint64_t sharedGeneration() const {
+        return m_shared != nullptr ? m_shared->generation() : 0;
+    }
+
+    std::string payload(Value<ValueType>& value) const {
+        if (isSerialized(value)) {
+            return serializedPayload(std::get<SerializedValue>(value.storage));
+        }
+        return encodeValue(getData(value, m_encoding), m_encoding);
+    }
+
+    void fitSizeImpl(BatchCompletion::Callback done) {
+        std::vector<DiskEngine::WriteRequest> writes;
+        std::shared_ptr<BatchCompletion> batch;
+        {
+            std::unique_lock lock(m_mutex);
+            auto candidates = demoteCandidates();
+            auto const clean = std::partition(candidates.begin(), candidates.end(), [] (auto const& node) {
+                return node->second.revision.dirty();
+            });
+
+            for (auto it = clean; it != candidates.end(); ++it) {
+                m_serializedBytes -= serializedSize((*it)->second);
+                auto path = writePath((*it)->first);
+                if (storeValue((*it)->second, path, m_encoding)) {
+                    unshare(path);
+                }
+                updateFootprint((*it)->second);
+            }
+            candidates.erase(clean, candidates.end());
+            batch = std::make_shared<BatchCompletion>(candidates.size(), std::move(done));
+
+            for (auto const& node: candidates) {
+                auto path = writePath(node->first);
+                auto data = payload(node->second);
+                auto const size = data.size();
+                writes.push_back(orderedWrite(node->first, path, std::move(data), beginWrite(node->first),
+                    [this, batch, key = node->first, path, size,
+                     index = node->second.storage.index(), stamp = node->second.lastAccess,
+                     revision = node->second.revision.current()] (bool ok) {
+                        if (ok) {
+                            std::unique_lock lock(m_mutex);
+                            auto const iter = m_container.find(key);
+                            if (iter == m_container.end()) {
+                                std::error_code error;
+                                std::filesystem::remove(path, error);
+                            } else {
+                                auto& value = iter->second;
+                                if (value.storage.index() == index and value.lastAccess == stamp 
+                                    and value.revision.current() == revision) {
+                                    m_serializedBytes -= serializedSize(value);
+                                    value.revision.markWritten(revision);
+                                    value.revision.reclaim();
+                                    value.storage = path;
+                                    updateFootprint(value);
+                                    unpublish(key);
+                                }
+                                recordFile(key, value.lastAccess, size);
+                            }
+                        }
+                        batch->complete(ok);
+                    }));
+            }
+        }
+
+        engine().submit(std::move(writes));
+    }
+
+    void flushImpl(BatchCompletion::Callback done) {
+        struct Written {
+            std::string key;
+            std::chrono::system_clock::time_point stamp;
+            uint64_t revision;
+            uint64_t sequence;
+            std::string data;
+        };
+
+        std::vector<Written> written;
+        {
+            std::shared_lock lock(m_mutex);
+            for (auto& node: m_container) {
+                if ((isCashed(node.second) or isSerialized(node.second)) and node.second.revision.dirty()) {
+                    written.push_back({node.first, node.second.lastAccess, node.second.revision.current(), 
+                                       beginWrite(node.first), payload(node.second)});
+                }
+            }
+        }
+
+        auto batch = std::make_shared<BatchCompletion>(written.size(), std::move(done));
+        std::vector<DiskEngine::WriteRequest> writes;
+        for (auto& item: written) {
+            auto const size = item.data.size();
+            writes.push_back(orderedWrite(item.key, writePath(item.key), std::move(item.data), item.sequence,
+                [this, batch, key = item.key, stamp = item.stamp, revision = item.revision, size] (bool ok) {
+                    if (ok) {
+                        recordWritten(key, stamp, revision, size);
+                    }
+                    batch->complete(ok);
+                }));
+        }
+
+        engine().submit(std::move(writes));
+    }
+
+    void prefetchImpl(std::vector<std::string> const& keys, BatchCompletion::Callback done) {
+        std::vector<DiskEngine::ReadRequest> reads;
+        std::vector<std::string> readKeys;
+        {
+            std::unique_lock lock(m_mutex);
+            for (auto const& key: keys) {
+                auto const iter = findNode(key);
+                if (iter == m_container.end()) {
+                    throw std::logic_error("Key not found: " + key);
+                }
+
+                if (isSerialized(iter->second)) {
+                    promote(iter->second);
+                } else if (isCashed(iter->second)) {
+                    continue;
+                } else if (loadShared(iter->second)) {
+                    updateFootprint(iter->second);
+                    applyDeltas(key, iter->second);
+                } else {
+                    reads.push_back({std::get<std::string>(iter->second.storage), {}});
+                    readKeys.push_back(key);
+                }
+            }
+        }
+
+        auto batch = std::make_shared<BatchCompletion>(reads.size(), std::move(done));
+        auto const generation = sharedGeneration();
+        for (size_t i = 0; i < reads.size(); ++i) {
+            reads[i].callback = [this, batch, key = std::move(readKeys[i]), path = reads[i].path, generation] 
+                (std::optional<std::string> bytes) {
+                batch->complete(installLoaded(key, path, std::move(bytes), generation, false) != nullptr);
+            };
+        }
+
+        engine().submit(std::move(reads));
+    }
+
+    // Decodes a completed reload and makes it resident, unless the entry was
+    // replaced or reloaded in the meantime. Returns the resident value, marked
+    // as modified when it is handed out for writing.
+    ValueType* installLoaded(std::string const& key,
+                             std::string const& path,
+                             std::optional<std::string> bytes,
+                             uint64_t generation,
+                             bool modify) {
+        std::optional<ValueType> data;
+        if (bytes.has_value()) {
+            share(path, *bytes, generation);
+            data = decodeValue<ValueType>(std::move(*bytes), m_encoding);
+        }
+
+        std::unique_lock lock(m_mutex);
+        auto const iter = m_container.find(key);
+        if (iter == m_container.end()) {
+            return nullptr;
+        }
+
+        auto const file = std::get_if<std::string>(&iter->second.storage);
+        if (file != nullptr and *file == path) {
+            if (not data.has_value()) {
+                return nullptr;
+            }
+            iter->second.storage = std::move(*data);
+            updateFootprint(iter->second);
+            applyDeltas(key, iter->second);
+        }
+
+        auto const value = std::get_if<ValueType>(&iter->second.storage);
+        if (value != nullptr and modify) {
+            markModified(key, iter->second);
+        }
+        return value;
+    }
+
+#if defined(BINARY_STORAGE_COROUTINES)
+    static BatchCompletion::Callback asyncCallback(std::shared_ptr<AsyncState<void>> state) {
+        return [state = std::move(state)] (bool ok) {
+            if (ok) {
+                state->setValue();
+            } else {
+                state->setException(std::make_exception_ptr(std::logic_error("Disk I/O error")));
+            }
+        };
+    }
+#endif
 
     void loadFiles() {
         namespace fs = std::filesystem;
@@ -129,20 +1790,54 @@ class Storage {
             }
         }
 
+        if (m_paramters.fanOutLevels > 3) {
+            throw std::logic_error("At most 3 fan-out levels are supported");
+        }
+        if (m_paramters.fanOutLevels != 0) {
+            m_directories = std::make_unique<std::atomic<bool>[]>(size_t {1} << (8 * m_paramters.fanOutLevels));
+        }
+
+        if (m_paramters.useManifest) {
+            openManifest();
+            return;
+        }
+
         if (not m_paramters.loadAllOnCreate) {
             return;
         }
 
-        for (auto const& entry: fs::directory_iterator(m_paramters.path)) {
-            if (not entry.is_regular_file()) {
-                continue;
-            }
+        for (auto& file: scanStoredFiles()) {
+            auto path = m_paramters.path + file.location;
+            m_container.insert({std::move(file.key), createFormFile<ValueType>(std::move(path))});
+        }
+    }
+
+    std::vector<StoredFile> scanStoredFiles() const {
+        return scanFiles(m_paramters.path, m_paramters.extension, m_paramters.fanOutLevels, encodedNames(), m_paramters.ioThreads);
+    }
 
-            if (entry.path().extension() != m_paramters.extension) {
-                continue;
+    // Maps the manifest, building it with a single directory scan the first
+    // time or when its checkpoint is damaged. With loadAllOnCreate keys are
+    // resolved from the manifest on first access, so startup does not depend
+    // on the number of stored values.
+    void openManifest() {
+        namespace fs = std::filesystem;
+        auto const exists = Manifest::exists(m_paramters.path);
+        m_manifest = std::make_unique<Manifest>(m_paramters.path);
+
+        if (not exists or m_manifest->rejected()) {
+            std::vector<Manifest::Entry> entries;
+            auto const now = std::chrono::system_clock::now();
+            auto const fileNow = fs::file_time_type::clock::now();
+            for (auto& file: scanStoredFiles()) {
+                auto const age = std::chrono::duration_cast<std::chrono::system_clock::duration>(fileNow - file.lastWrite);
+                entries.push_back({std::move(file.key), std::move(file.location), file.size, now - age});
             }
+            m_manifest->rebuild(std::move(entries));
+        }
 
-            m_container.insert({entry.path().filename(), createFormFile<ValueType>(std::move(entry.path()))});
+        if (m_paramters.loadAllOnCreate) {
+            m_unloaded = m_manifest->count();
         }
     }
 };
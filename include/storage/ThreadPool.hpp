@@ -0,0 +1,151 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace binary_storage::storage {
+
+class ThreadPool {
+   public:
+    using Task = std::function<void()>;
+
+   public:
+    explicit ThreadPool(size_t threads = std::thread::hardware_concurrency()) {
+        if (threads == 0) {
+            threads = 1;
+        }
+
+        m_workers.reserve(threads);
+        for (size_t i = 0; i < threads; ++i) {
+            m_workers.emplace_back([this] { workerLoop(); });
+        }
+    }
+
+    ThreadPool(ThreadPool const&) = delete;
+    ThreadPool(ThreadPool&&) noexcept = delete;
+    ThreadPool& operator=(ThreadPool const&) = delete;
+    ThreadPool& operator=(ThreadPool&&) noexcept = delete;
+
+    ~ThreadPool() noexcept {
+        {
+            std::unique_lock lock(m_mutex);
+            m_stoped = true;
+        }
+        m_condition.notify_all();
+
+        for (auto& worker: m_workers) {
+            worker.join();
+        }
+    }
+
+   public:
+    void post(Task task) {
+        {
+            std::unique_lock lock(m_mutex);
+            m_tasks.push_back(std::move(task));
+        }
+        m_condition.notify_one();
+    }
+
+    template<class F>
+    auto submit(F&& function) -> std::future<std::invoke_result_t<F>> {
+        using Result = std::invoke_result_t<F>;
+        auto task = std::make_shared<std::packaged_task<Result()>>(std::forward<F>(function));
+        auto future = task->get_future();
+        post([task] { (*task)(); });
+        return future;
+    }
+
+    // Runs task(i) for every i in [0, count) on the workers and the calling
+    // thread. Each thread takes the next unclaimed index until none is left, so
+    // threads that finish early pick up the rest and uneven tasks balance out.
+    // Safe to call from a worker, the caller alone can run every task. The
+    // first exception thrown by a task is rethrown once all are done.
+    template<class F>
+    void parallelFor(size_t count, F const& task) {
+        if (count == 0) {
+            return;
+        }
+
+        struct State {
+            std::atomic<size_t> next {0};
+            size_t done {0};
+            std::exception_ptr error;
+            std::mutex mutex;
+            std::condition_variable condition;
+        };
+
+        auto state = std::make_shared<State>();
+        auto const run = [state, count, &task] {
+            for (auto i = state->next.fetch_add(1); i < count; i = state->next.fetch_add(1)) {
+                std::exception_ptr error;
+                try {
+                    task(i);
+                } catch (...) {
+                    error = std::current_exception();
+                }
+
+                std::lock_guard lock(state->mutex);
+                if (error != nullptr and state->error == nullptr) {
+                    state->error = error;
+                }
+                if (++state->done == count) {
+                    state->condition.notify_all();
+                }
+            }
+        };
+
+        for (size_t i = 0; i < std::min(threads(), count - 1); ++i) {
+            post(run);
+        }
+        run();
+
+        std::unique_lock lock(state->mutex);
+        state->condition.wait(lock, [&] { return state->done == count; });
+        if (state->error != nullptr) {
+            std::rethrow_exception(state->error);
+        }
+    }
+
+    size_t threads() const noexcept {
+        return m_workers.size();
+    }
+
+   private:
+    std::mutex m_mutex;
+    std::condition_variable m_condition;
+    std::deque<Task> m_tasks;
+    std::vector<std::thread> m_workers;
+    bool m_stoped {false};
+
+   private:
+    void workerLoop() noexcept {
+        while (true) {
+            Task task;
+            {
+                std::unique_lock lock(m_mutex);
+                m_condition.wait(lock, [this] { return m_stoped or not m_tasks.empty(); });
+                if (m_tasks.empty()) {
+                    return;
+                }
+
+                task = std::move(m_tasks.front());
+                m_tasks.pop_front();
+            }
+
+            task();
+        }
+    }
+};
+
+} // namespace binary_storage::storage
@@ -0,0 +1,148 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <iterator>
+#include <limits>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace binary_storage::storage {
+
+// Hierarchical timing wheel of key deadlines in ticks. Level 0 has a slot
+// per tick, every next level a slot per full turn of the one below; timers
+// move one level down when the wheel reaches their slot, so scheduling and
+// expiring a timer are O(1). Every level keeps a bitmap of its occupied slots
+// and the wheel jumps straight to the next tick with a slot to fire or to
+// cascade, so idle stretches cost nothing. Timers are not cancelled, the
+// owner checks that a fired deadline is still the current one. Not thread
+// safe.
+class TimingWheel {
+   public:
+    struct Timer {
+        std::string key;
+        uint64_t deadline;
+    };
+
+   public:
+    void schedule(std::string key, uint64_t deadline) {
+        ++m_size;
+        place({std::move(key), deadline});
+    }
+
+    // Moves the wheel to the tick and returns the timers that are due.
+    std::vector<Timer> advance(uint64_t tick) {
+        std::vector<Timer> due;
+        while (m_current < tick and m_size != m_due.size() + due.size()) {
+            m_current = std::min(nextEvent(), tick);
+            cascade();
+            auto const index = m_current & slotMask;
+            auto& slot = m_levels[0][index];
+            std::move(slot.begin(), slot.end(), std::back_inserter(due));
+            slot.clear();
+            m_occupied[0] &= ~(uint64_t {1} << index);
+        }
+
+        m_current = std::max(m_current, tick);
+        std::move(m_due.begin(), m_due.end(), std::back_inserter(due));
+        m_due.clear();
+        m_size -= due.size();
+        return due;
+    }
+
+    uint64_t current() const noexcept {
+        return m_current;
+    }
+
+    size_t size() const noexcept {
+        return m_size;
+    }
+
+   private:
+    static constexpr size_t slotBits {6};
+    static constexpr size_t slotsCount {size_t {1} << slotBits};
+    static constexpr uint64_t slotMask {slotsCount - 1};
+    static constexpr size_t levelsCount {4};
+
+    using Level = std::array<std::vector<Timer>, slotsCount>;
+
+    std::array<Level, levelsCount> m_levels;
+    std::array<uint64_t, levelsCount> m_occupied {};
+    std::vector<Timer> m_overflow;
+    std::vector<Timer> m_due;
+    uint64_t m_current {0};
+    size_t m_size {0};
+
+   private:
+    void place(Timer timer) {
+        if (timer.deadline <= m_current) {
+            m_due.push_back(std::move(timer));
+            return;
+        }
+
+        auto const delta = timer.deadline - m_current;
+        for (size_t level = 0; level < levelsCount; ++level) {
+            if (delta < (uint64_t {1} << (slotBits * (level + 1)))) {
+                auto const index = (timer.deadline >> (slotBits * level)) & slotMask;
+                m_levels[level][index].push_back(std::move(timer));
+                m_occupied[level] |= uint64_t {1} << index;
+                return;
+            }
+        }
+        m_overflow.push_back(std::move(timer));
+    }
+
+    // First tick after the current one where a level 0 slot fires or a slot of
+    // a level above is spread below. Requires timers outside m_due.
+    uint64_t nextEvent() const noexcept {
+        auto next = std::numeric_limits<uint64_t>::max();
+        if (not m_overflow.empty()) {
+            next = ((m_current >> (slotBits * levelsCount)) + 1) << (slotBits * levelsCount);
+        }
+
+        // The slot of a level reached k turns of the level below from now is
+        // (turn + k) & slotMask, the bitmap is rotated so that k = 1 comes first.
+        for (size_t level = 0; level < levelsCount; ++level) {
+            if (m_occupied[level] == 0) {
+                continue;
+            }
+
+            auto const turn = m_current >> (slotBits * level);
+            auto const start = (turn + 1) & slotMask;
+            auto const rotated = start == 0
+                ? m_occupied[level]
+                : (m_occupied[level] >> start) | (m_occupied[level] << (slotsCount - start));
+            auto const turns = static_cast<uint64_t>(__builtin_ctzll(rotated)) + 1;
+            next = std::min(next, (turn + turns) << (slotBits * level));
+        }
+        return next;
+    }
+
+    // On a turn of a level the next slot of the level above is spread below,
+    // starting from the top so no timer lands in a slot that was just emptied.
+    void cascade() {
+        if ((m_current & ((uint64_t {1} << (slotBits * levelsCount)) - 1)) == 0) {
+            replace(m_overflow);
+        }
+
+        for (size_t level = levelsCount - 1; level > 0; --level) {
+            if ((m_current & ((uint64_t {1} << (slotBits * level)) - 1)) == 0) {
+                auto const index = (m_current >> (slotBits * level)) & slotMask;
+                m_occupied[level] &= ~(uint64_t {1} << index);
+                replace(m_levels[level][index]);
+            }
+        }
+    }
+
+    void replace(std::vector<Timer>& slot) {
+        auto timers = std::move(slot);
+        slot.clear();
+        for (auto& timer: timers) {
+            place(std::move(timer));
+        }
+    }
+};
+
+} // namespace binary_storage::storage
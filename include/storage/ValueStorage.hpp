@@ -4,20 +4,181 @@
 #include <fstream>
 #include <chrono>
 #include <optional>
+#include <sstream>
+#include <atomic>
+#include <algorithm>
 
 #include "serde/traits.hpp"
 #include "serde/serde.hpp"
+#include "serde/chunked.hpp"
+#include "serde/columnar.hpp"
+#include "serde/parallel.hpp"
+#include "serde/footprint.hpp"
+#include "Compression.hpp"
+
+#if __has_include(<unistd.h>) and __has_include(<fcntl.h>)
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#define BINARY_STORAGE_POSITIONED_WRITES 1
+#endif
 
 namespace binary_storage::storage {
 
+// Evicted value kept in memory in its serialized form, optionally compressed.
+struct SerializedValue {
+    std::string bytes;
+    size_t size {0};
+    bool compressed {false};
+};
+
+// Layout of values in files and in the serialized tier. Vectors of reflectable
+// records are written column by column when columnar is set, other vectors in
+// the chunked encoding when chunkElements is set. Other types ignore both.
+// With parallelFor set the chunks are encoded and decoded concurrently.
+struct Encoding {
+    size_t chunkElements {0};
+    bool columnar {false};
+    serde::ParallelFor parallelFor {};
+};
+
+template<class T>
+constexpr bool isColumnar(Encoding const& encoding) noexcept {
+    if constexpr (serde::isRecordVector<T>) {
+        return encoding.columnar;
+    } else {
+        return false;
+    }
+}
+
+template<class T>
+constexpr bool isChunked(Encoding const& encoding) noexcept {
+    if constexpr (serde::isContiguous<T>) {
+        return encoding.chunkElements != 0 and not isColumnar<T>(encoding);
+    } else {
+        return false;
+    }
+}
+
+template<class T>
+bool isParallel(Encoding const& encoding) noexcept {
+    return isChunked<T>(encoding) and static_cast<bool>(encoding.parallelFor);
+}
+
+template<class S, class T>
+void writeValue(S& stream, T const& data, Encoding const& encoding) {
+    if constexpr (serde::isRecordVector<T>) {
+        if (isColumnar<T>(encoding)) {
+            serde::serializeColumnar(stream, data);
+            return;
+        }
+    }
+    if constexpr (serde::isContiguous<T>) {
+        if (isParallel<T>(encoding)) {
+            serde::serializeChunkedParallel(stream, data, encoding.chunkElements, encoding.parallelFor);
+            return;
+        }
+        if (isChunked<T>(encoding)) {
+            serde::serializeChunked(stream, data, encoding.chunkElements);
+            return;
+        }
+    }
+    serde::serialize(stream, data);
+}
+
+template<class T, class S>
+std::optional<T> readValue(S& stream, Encoding const& encoding) {
+    if constexpr (serde::isRecordVector<T>) {
+        if (isColumnar<T>(encoding)) {
+            return serde::deserializeColumnar<T>(stream);
+        }
+    }
+    if constexpr (serde::isContiguous<T>) {
+        if (isChunked<T>(encoding)) {
+            return serde::deserializeChunked<T>(stream);
+        }
+    }
+    return serde::deserialize<T>(stream);
+}
+
+template<class T>
+size_t encodedSize(T const& data, Encoding const& encoding) noexcept {
+    if constexpr (serde::isContiguous<T>) {
+        if (isChunked<T>(encoding)) {
+            return serde::serializedChunkedSize(data, encoding.chunkElements);
+        }
+    }
+    return serde::serializedSize(data);
+}
+
+// Tracks whether the value's file matches its data. Every modification bumps the
+// current revision, possibly under a shared lock, the written revision is the
+// last one stored in the file. Data lent out through a mutable reference can
+// change without a bump, so it stays dirty until it leaves memory.
+class Revision {
+   public:
+    Revision(bool dirty = true) noexcept :
+        m_current {dirty ? 1u : 0u} {}
+
+    Revision(Revision const& other) noexcept :
+        m_current {other.current()},
+        m_written {other.m_written},
+        m_lent {other.m_lent.load(std::memory_order_relaxed)} {}
+
+    Revision& operator=(Revision const& other) noexcept {
+        m_current.store(other.current(), std::memory_order_relaxed);
+        m_written = other.m_written;
+        m_lent.store(other.m_lent.load(std::memory_order_relaxed), std::memory_order_relaxed);
+        return *this;
+    }
+
+    void touch() noexcept {
+        m_current.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    // The data was handed out for modification.
+    void lend() noexcept {
+        m_lent.store(true, std::memory_order_relaxed);
+        touch();
+    }
+
+    // The data left memory, references lent before are no longer valid.
+    void reclaim() noexcept {
+        m_lent.store(false, std::memory_order_relaxed);
+    }
+
+    uint64_t current() const noexcept {
+        return m_current.load(std::memory_order_relaxed);
+    }
+
+    void markWritten(uint64_t revision) noexcept {
+        m_written = std::max(m_written, revision);
+    }
+
+    bool dirty() const noexcept {
+        return m_lent.load(std::memory_order_relaxed) or current() != m_written;
+    }
+
+   private:
+    std::atomic<uint64_t> m_current;
+    uint64_t m_written {0};
+    std::atomic<bool> m_lent {false};
+};
+
 template<class T>
 struct Value {
     using ValueType = T;
-    using StorageType = std::variant<ValueType, std::string>;
+    using StorageType = std::variant<ValueType, std::string, SerializedValue>;
     static_assert(std::is_copy_constructible_v<ValueType> or std::is_move_constructible_v<ValueType>, "Value type must be copy constructible or move constructible");
 
     StorageType storage;
     std::chrono::system_clock::time_point lastAccess;
+    Revision revision;
+    uint64_t epoch {0};
+    // Memory footprint of the resident data when it was last measured.
+    size_t footprint {0};
+    // Serialized size of the resident data when it was last measured.
+    size_t bytes {0};
 };
 
 template<class T>
@@ -27,18 +188,153 @@ template<class T>
 void updateData(T&& data, Value<std::remove_const_t<std::remove_reference_t<T>>>& value) {
     value.lastAccess = std::chrono::system_clock::now();
     value.storage = std::forward<T>(data);
+    value.revision.touch();
+}
+
+inline std::string serializedPayload(SerializedValue const& value) {
+    if (not value.compressed) {
+        return value.bytes;
+    }
+
+    auto payload = decompress(value.bytes, value.size);
+    if (not payload.has_value()) {
+        throw std::logic_error("Decompress error");
+    }
+    return std::move(*payload);
+}
+
+template<class T>
+std::string encodeValue(T const& data, Encoding const& encoding = {}) {
+    std::ostringstream stream;
+    writeValue(stream, data, encoding);
+    return stream.str();
+}
+
+template<class T>
+std::optional<T> decodeValue(std::string bytes, Encoding const& encoding = {}) {
+    if constexpr (serde::isContiguous<T>) {
+        if (isParallel<T>(encoding)) {
+            return serde::deserializeChunkedParallel<T>(bytes, encoding.parallelFor);
+        }
+    }
+    std::istringstream stream(std::move(bytes));
+    return readValue<T>(stream, encoding);
+}
+
+#if defined(BINARY_STORAGE_POSITIONED_WRITES)
+inline bool writeAt(int fd, std::string_view bytes, uint64_t offset) noexcept {
+    while (not bytes.empty()) {
+        auto const written = pwrite(fd, bytes.data(), bytes.size(), static_cast<off_t>(offset));
+        if (written < 0 and errno == EINTR) {
+            continue;
+        }
+        if (written <= 0) {
+            return false;
+        }
+        bytes.remove_prefix(static_cast<size_t>(written));
+        offset += static_cast<uint64_t>(written);
+    }
+    return true;
 }
+#endif
 
+// Writes a chunked vector with its chunks encoded concurrently. The file is
+// sized once and every chunk is written at its own offset by the thread that
+// encoded it, without going through a shared stream.
 template<class T>
-void storeValue(Value<T>& value, std::string path) {
+void writeParallel(std::string const& path, T const& data, Encoding const& encoding) {
+    auto const buffers = serde::encodeChunkedParallel(data, encoding.chunkElements, encoding.parallelFor);
+#if defined(BINARY_STORAGE_POSITIONED_WRITES)
+    auto const fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        throw std::logic_error("Can't open file: " + path);
+    }
+
+    std::vector<uint64_t> offsets {buffers.header.size()};
+    for (auto const& chunk: buffers.chunks) {
+        offsets.push_back(offsets.back() + chunk.size());
+    }
+
+    std::atomic<bool> failed {ftruncate(fd, static_cast<off_t>(offsets.back())) != 0};
+    if (not failed) {
+        encoding.parallelFor(buffers.chunks.size() + 1, [&] (size_t i) {
+            auto const& bytes = i == 0 ? buffers.header : buffers.chunks[i - 1];
+            if (not writeAt(fd, bytes, i == 0 ? 0 : offsets[i - 1])) {
+                failed = true;
+            }
+        });
+    }
+    close(fd);
+    if (failed) {
+        throw std::logic_error("Can't write file: " + path);
+    }
+#else
+    std::ofstream stream(path, std::ios::binary);
+    stream.write(buffers.header.data(), static_cast<std::streamsize>(buffers.header.size()));
+    for (auto const& chunk: buffers.chunks) {
+        stream.write(chunk.data(), static_cast<std::streamsize>(chunk.size()));
+    }
+    if (not stream.flush()) {
+        throw std::logic_error("Can't write file: " + path);
+    }
+#endif
+}
+
+// Reads a value file, chunked vectors decoded in parallel are read whole.
+template<class T>
+std::optional<T> readValueFile(std::string const& path, Encoding const& encoding) {
+    std::ifstream stream(path, std::ios::binary);
+    if constexpr (serde::isContiguous<T>) {
+        if (isParallel<T>(encoding)) {
+            stream.seekg(0, std::ios::end);
+            std::string bytes(static_cast<size_t>(std::max<std::streamoff>(stream.tellg(), 0)), '\0');
+            stream.seekg(0);
+            stream.read(bytes.data(), static_cast<std::streamsize>(bytes.size()));
+            return serde::deserializeChunkedParallel<T>(bytes, encoding.parallelFor);
+        }
+    }
+    return readValue<T>(stream, encoding);
+}
+
+// Evicts the value to its file, returns false when the file already holds
+// the data and only the in-memory copy was dropped. Throws when the file
+// can't be written, the value then stays in memory and dirty.
+template<class T>
+bool storeValue(Value<T>& value, std::string path, Encoding const& encoding = {}) {
     value.lastAccess = std::chrono::system_clock::now();
-    if (not std::holds_alternative<T>(value.storage)) {
-        return;
+    if (std::holds_alternative<std::string>(value.storage)) {
+        return false;
+    }
+
+    if (not value.revision.dirty()) {
+        value.storage = std::move(path);
+        return false;
+    }
+
+    if constexpr (serde::isContiguous<T>) {
+        if (auto const data = std::get_if<T>(&value.storage); data != nullptr and isParallel<T>(encoding)) {
+            writeParallel(path, *data, encoding);
+            value.revision.markWritten(value.revision.current());
+            value.revision.reclaim();
+            value.storage = std::move(path);
+            return true;
+        }
     }
 
-    std::ofstream stream(path);
-    serde::serialize(stream, std::get<T>(value.storage));
-    value.storage = std::move(path); 
+    std::ofstream stream(path, std::ios::binary | std::ios::trunc);
+    if (std::holds_alternative<T>(value.storage)) {
+        writeValue(stream, std::get<T>(value.storage), encoding);
+    } else {
+        auto const payload = serializedPayload(std::get<SerializedValue>(value.storage));
+        stream.write(payload.data(), static_cast<std::streamsize>(payload.size()));
+    }
+    if (not stream.flush()) {
+        throw std::logic_error("Can't write file: " + path);
+    }
+    value.revision.markWritten(value.revision.current());
+    value.revision.reclaim();
+    value.storage = std::move(path);
+    return true;
 }
 
 template<class T>
@@ -47,13 +343,30 @@ bool isCashed(Value<T> const& value) noexcept {
 }
 
 template<class T>
-T& getData(Value<T>& value) {
+bool isSerialized(Value<T> const& value) noexcept {
+    return std::holds_alternative<SerializedValue>(value.storage);
+}
+
+// Memory held by a value in the serialized tier.
+template<class T>
+size_t serializedSize(Value<T> const& value) noexcept {
+    auto const serialized = std::get_if<SerializedValue>(&value.storage);
+    return serialized == nullptr ? 0 : serialized->bytes.capacity();
+}
+
+template<class T>
+T& getData(Value<T>& value, Encoding const& encoding = {}) {
     if (std::holds_alternative<T>(value.storage)) {
         return std::get<T>(value.storage);
     }
 
-    std::ifstream stream(std::get<std::string>(value.storage));
-    auto data = serde::deserialize<T>(stream);
+    std::optional<T> data;
+    if (std::holds_alternative<SerializedValue>(value.storage)) {
+        data = decodeValue<T>(serializedPayload(std::get<SerializedValue>(value.storage)), encoding);
+    } else {
+        data = readValueFile<T>(std::get<std::string>(value.storage), encoding);
+    }
+
     if (not data.has_value()) {
         throw std::logic_error("Deserialize eror");
     }
@@ -67,14 +380,133 @@ T& getData(Value<T>& value) {
     return std::get<T>(value.storage);
 }
 
+// Reads the given members of a value without making it resident: resident
+// values are copied from, evicted ones are decoded skipping the other members.
+template<auto... Members, class T>
+std::optional<serde::Projection<Members...>> projectValue(Value<T> const& value) {
+    if (auto const data = std::get_if<T>(&value.storage); data != nullptr) {
+        return serde::Projection<Members...> {(*data).*Members...};
+    }
+
+    if (auto const serialized = std::get_if<SerializedValue>(&value.storage); serialized != nullptr) {
+        std::istringstream stream(serializedPayload(*serialized));
+        return serde::deserializeFields<Members...>(stream);
+    }
+
+    std::ifstream stream(std::get<std::string>(value.storage), std::ios::binary);
+    return serde::deserializeFields<Members...>(stream);
+}
+
+// Elements [begin, end) of a vector value without making it resident, evicted
+// values are read from the chunk holding begin or by seeking over the elements
+// before it. The end is clamped to the size of the vector.
+template<class T>
+std::optional<T> sliceValue(Value<T> const& value, size_t begin, size_t end, Encoding const& encoding = {}) {
+    static_assert(serde::isContiguous<T>, "Only contiguous vectors can be sliced");
+    if (auto const data = std::get_if<T>(&value.storage); data != nullptr) {
+        end = std::min(end, data->size());
+        return begin >= end ? T {} : T(data->begin() + begin, data->begin() + end);
+    }
+
+    auto const read = [&] (auto& stream) {
+        return isChunked<T>(encoding) 
+            ? serde::deserializeChunkedRange<T>(stream, begin, end)
+            : serde::deserializeRange<T>(stream, begin, end);
+    };
+
+    if (auto const serialized = std::get_if<SerializedValue>(&value.storage); serialized != nullptr) {
+        std::istringstream stream(serializedPayload(*serialized));
+        return read(stream);
+    }
+
+    std::ifstream stream(std::get<std::string>(value.storage), std::ios::binary);
+    return read(stream);
+}
+
+// Columns of the given members over all records of a vector value, without
+// making it resident. Only the requested columns are decoded in the columnar
+// encoding, the plain one is read record by record skipping other members.
+template<auto... Members, class T>
+std::optional<serde::Columns<Members...>> columnsValue(Value<T> const& value, Encoding const& encoding = {}) {
+    static_assert(std::is_same_v<T, std::vector<serde::ProjectionClass<Members...>>>, "Members must belong to the records");
+    if (auto const data = std::get_if<T>(&value.storage); data != nullptr) {
+        serde::Columns<Members...> result;
+        std::apply([&] (auto&... columns) { (columns.reserve(data->size()), ...); }, result);
+        for (auto const& record: *data) {
+            serde::appendFields(result, serde::Projection<Members...> {record.*Members...}, 
+                                std::index_sequence_for<decltype(Members)...> {});
+        }
+        return result;
+    }
+
+    auto const read = [&] (auto& stream) -> std::optional<serde::Columns<Members...>> {
+        if (isColumnar<T>(encoding)) {
+            return serde::deserializeColumns<Members...>(stream);
+        }
+        if (not isChunked<T>(encoding)) {
+            return serde::deserializeColumnsFromRows<Members...>(stream);
+        }
+
+        auto const records = readValue<T>(stream, encoding);
+        if (not records.has_value()) {
+            return std::nullopt;
+        }
+        return columnsValue<Members...>(Value<T> {std::move(*records), value.lastAccess, true, value.epoch, 0, 0});
+    };
+
+    if (auto const serialized = std::get_if<SerializedValue>(&value.storage); serialized != nullptr) {
+        std::istringstream stream(serializedPayload(*serialized));
+        return read(stream);
+    }
+
+    std::ifstream stream(std::get<std::string>(value.storage), std::ios::binary);
+    return read(stream);
+}
+
+// Copy of the data that leaves the value untouched, evicted values are decoded.
+template<class T>
+std::optional<T> readData(Value<T> const& value, Encoding const& encoding = {}) {
+    if (auto const data = std::get_if<T>(&value.storage); data != nullptr) {
+        return *data;
+    }
+
+    if (auto const serialized = std::get_if<SerializedValue>(&value.storage); serialized != nullptr) {
+        return decodeValue<T>(serializedPayload(*serialized), encoding);
+    }
+    return readValueFile<T>(std::get<std::string>(value.storage), encoding);
+}
+
+// Moves a resident value into the serialized tier, returns the memory it holds there.
+template<class T>
+size_t demoteValue(Value<T>& value, bool compressed, Encoding const& encoding = {}) {
+    value.lastAccess = std::chrono::system_clock::now();
+    if (not std::holds_alternative<T>(value.storage)) {
+        return serializedSize(value);
+    }
+
+    SerializedValue serialized;
+    serialized.bytes = encodeValue(std::get<T>(value.storage), encoding);
+    serialized.size = serialized.bytes.size();
+    if (compressed) {
+        if (auto packed = compress(serialized.bytes); packed.has_value()) {
+            serialized.bytes = std::move(*packed);
+            serialized.compressed = true;
+        }
+    }
+
+    value.revision.reclaim();
+    value.storage = std::move(serialized);
+    return serializedSize(value);
+}
+
 template<class T>
 Value<RemoveCRType<T>> createFromData(T&& data) {
-    return {std::forward<T>(data), std::chrono::system_clock::now()};
+    return {std::forward<T>(data), std::chrono::system_clock::now(), true, 0, 0, 0};
 }
 
 template<class T>
 Value<T> createFormFile(std::string path) {
-    return {std::move(path), std::chrono::system_clock::now()};
+    return {std::move(path), std::chrono::system_clock::now(), false, 0, 0, 0};
 }
 
 } // namespace binary_storage::storage
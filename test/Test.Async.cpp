@@ -0,0 +1,121 @@
+#include <gtest/gtest.h>
+
+#include <storage/Storage.hpp>
+
+#if defined(BINARY_STORAGE_COROUTINES)
+
+#include <filesystem>
+#include <thread>
+
+#include "Test.Parameters.hpp"
+
+using namespace binary_storage::storage;
+
+namespace {
+
+struct Detached {
+    struct promise_type {
+        Detached get_return_object() noexcept {
+            return {};
+        }
+
+        std::suspend_never initial_suspend() noexcept {
+            return {};
+        }
+
+        std::suspend_never final_suspend() noexcept {
+            return {};
+        }
+
+        void return_void() noexcept {}
+
+        void unhandled_exception() noexcept {
+            std::terminate();
+        }
+    };
+};
+
+Detached loadTwice(Storage<std::vector<int>>& storage, std::promise<std::pair<size_t, size_t>>& result) {
+    auto& first = co_await storage.loadAsync("0");
+    auto& second = co_await storage.loadAsync("1");
+    result.set_value({first.size(), second.size()});
+}
+
+Detached storeAndFlush(Storage<std::vector<int>>& storage, std::promise<void>& result) {
+    co_await storage.storeAsync("stored", std::vector<int>(5, 1));
+    co_await storage.flushAsync();
+    result.set_value();
+}
+
+Detached resumeOn(Async<void> awaitable, std::promise<std::thread::id>& result) {
+    co_await awaitable;
+    result.set_value(std::this_thread::get_id());
+}
+
+} // namespace
+
+TEST(Async, residentLoadDoesNotSuspend) {
+    Storage<std::vector<int>> storage(parameters("residentLoad", 2));
+    storage.store("0", std::vector<int>(3, 0));
+
+    auto awaitable = storage.loadAsync("0");
+    ASSERT_TRUE(awaitable.await_ready());
+    ASSERT_EQ(awaitable.await_resume().size(), 3);
+    ASSERT_THROW(storage.loadAsync("missing"), std::logic_error);
+}
+
+TEST(Async, evictedLoad) {
+    Storage<std::vector<int>> storage(parameters("evictedLoad", 2));
+    for (int i = 0; i < 4; ++i) {
+        storage.store(std::to_string(i), std::vector<int>(i + 1, i));
+    }
+    storage.fitSize();
+
+    std::promise<std::pair<size_t, size_t>> result;
+    auto future = result.get_future();
+    loadTwice(storage, result);
+    ASSERT_EQ(future.get(), std::make_pair(size_t {1}, size_t {2}));
+}
+
+TEST(Async, expiredLoad) {
+    auto params = parameters("expiredLoad", 2);
+    Storage<std::vector<int>> storage(params);
+    storage.store("resident", {1}, std::chrono::milliseconds {10});
+    storage.store("0", {0});
+    storage.store("1", {1});
+    storage.store("evicted", {2}, std::chrono::milliseconds {10});
+    storage.fitSize();
+    std::this_thread::sleep_for(std::chrono::milliseconds {30});
+
+    ASSERT_THROW(storage.loadAsync("resident"), std::logic_error);
+    ASSERT_THROW(storage.loadAsync("evicted"), std::logic_error);
+}
+
+TEST(Async, storeAndFlush) {
+    auto params = parameters("storeAndFlush", 2);
+    Storage<std::vector<int>> storage(params);
+
+    std::promise<void> result;
+    auto future = result.get_future();
+    storeAndFlush(storage, result);
+    future.get();
+    ASSERT_TRUE(std::filesystem::exists(params.path + "stored.bin"));
+}
+
+TEST(Async, executor) {
+    ThreadPool pool(1);
+    auto const poolThread = pool.submit([] { return std::this_thread::get_id(); }).get();
+    Executor executor = [&pool] (std::function<void()> task) {
+        pool.post(std::move(task));
+    };
+
+    auto state = std::make_shared<AsyncState<void>>(executor);
+    std::promise<std::thread::id> result;
+    auto future = result.get_future();
+    resumeOn(Async<void>(state), result);
+
+    state->setValue();
+    ASSERT_EQ(future.get(), poolThread);
+}
+
+#endif
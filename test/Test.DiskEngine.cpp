@@ -0,0 +1,58 @@
+#include <gtest/gtest.h>
+
+#include <storage/DiskEngine.hpp>
+#include <filesystem>
+
+using namespace binary_storage::storage;
+
+static std::string const directory {"/tmp/binary_storage_engine/"};
+
+static void roundTrip(DiskEngine& engine) {
+    std::filesystem::create_directories(directory);
+
+    std::vector<DiskEngine::WriteRequest> writes;
+    std::vector<std::future<bool>> written;
+    for (int i = 0; i < 32; ++i) {
+        auto promise = std::make_shared<std::promise<bool>>();
+        written.push_back(promise->get_future());
+        writes.push_back({directory + std::to_string(i), std::string(i * 1000, 'a' + i % 26), [promise] (bool ok) {
+            promise->set_value(ok);
+        }});
+    }
+    engine.submit(std::move(writes));
+
+    for (auto& result: written) {
+        ASSERT_TRUE(result.get());
+    }
+
+    for (int i = 0; i < 32; ++i) {
+        auto const data = engine.read(directory + std::to_string(i)).get();
+        ASSERT_TRUE(data.has_value());
+        ASSERT_EQ(*data, std::string(i * 1000, 'a' + i % 26));
+    }
+
+    ASSERT_FALSE(engine.read(directory + "missing").get().has_value());
+    std::filesystem::remove_all(directory);
+}
+
+TEST(DiskEngine, threadPool) {
+    ThreadPoolEngine engine(4);
+    roundTrip(engine);
+}
+
+TEST(DiskEngine, automatic) {
+    auto engine = makeDiskEngine(DiskEngineKind::Auto, 2, 8);
+    roundTrip(*engine);
+}
+
+#if defined(BINARY_STORAGE_WITH_IO_URING)
+TEST(DiskEngine, ioUring) {
+    std::unique_ptr<DiskEngine> engine;
+    try {
+        engine = makeDiskEngine(DiskEngineKind::IoUring, 0, 8);
+    } catch (std::system_error const&) {
+        GTEST_SKIP() << "io_uring is not permitted here";
+    }
+    roundTrip(*engine);
+}
+#endif
@@ -0,0 +1,117 @@
+#include <gtest/gtest.h>
+
+#include <storage/Storage.hpp>
+#include <filesystem>
+
+using namespace binary_storage::storage;
+
+TEST(EvictionPolicy, frequencySketch) {
+    FrequencySketch sketch(1024);
+    for (int i = 0; i < 10; ++i) {
+        sketch.increment("hot");
+    }
+    sketch.increment("cold");
+
+    ASSERT_EQ(sketch.estimate("hot"), 10);
+    ASSERT_GE(sketch.estimate("cold"), 1);
+    ASSERT_LT(sketch.estimate("cold"), 10);
+
+    for (int i = 0; i < 100; ++i) {
+        sketch.increment("hot");
+    }
+    ASSERT_EQ(sketch.estimate("hot"), 15);
+}
+
+TEST(EvictionPolicy, recency) {
+    auto const now = std::chrono::system_clock::now();
+    std::vector<std::string> const keys {"a", "b", "c"};
+    std::vector<EvictionPolicy::Candidate> candidates {
+        {&keys[0], now, 0}, {&keys[1], now - std::chrono::seconds(2), 0}, {&keys[2], now - std::chrono::seconds(1), 0}};
+
+    RecencyPolicy policy;
+    ASSERT_EQ(policy.selectVictims(candidates, {1, 0}), (std::vector<size_t> {1, 2}));
+    ASSERT_TRUE(policy.selectVictims(candidates, {3, 0}).empty());
+}
+
+TEST(EvictionPolicy, tinyLfuPrefersFrequent) {
+    auto const now = std::chrono::system_clock::now();
+    std::vector<std::string> const keys {"hot", "scan", "warm"};
+    std::vector<EvictionPolicy::Candidate> candidates {
+        {&keys[0], now - std::chrono::seconds(5), 0}, {&keys[1], now, 0}, {&keys[2], now, 0}};
+
+    TinyLfuPolicy policy(64, 0);
+    for (int i = 0; i < 5; ++i) {
+        policy.recordAccess("hot");
+    }
+    policy.recordAccess("warm");
+    policy.recordAccess("warm");
+    policy.recordAccess("scan");
+
+    ASSERT_EQ(policy.selectVictims(candidates, {1, 0}), (std::vector<size_t> {1, 2}));
+}
+
+TEST(EvictionPolicy, tinyLfuByteBudget) {
+    auto const now = std::chrono::system_clock::now();
+    std::vector<std::string> const keys {"small", "huge", "other"};
+    std::vector<EvictionPolicy::Candidate> candidates {
+        {&keys[0], now, 100}, {&keys[1], now, 100000}, {&keys[2], now, 100}};
+
+    TinyLfuPolicy policy(64, 0);
+    for (int i = 0; i < 5; ++i) {
+        policy.recordAccess("small");
+        policy.recordAccess("huge");
+        policy.recordAccess("other");
+    }
+
+    ASSERT_EQ(policy.selectVictims(candidates, {3, 1000}), (std::vector<size_t> {1}));
+}
+
+TEST(EvictionPolicy, tinyLfuAdmission) {
+    auto const now = std::chrono::system_clock::now();
+    std::vector<std::string> const keys {"old", "recent", "new"};
+    std::vector<EvictionPolicy::Candidate> candidates {
+        {&keys[0], now - std::chrono::seconds(3), 0}, {&keys[1], now - std::chrono::seconds(2), 0}};
+
+    TinyLfuPolicy policy(64, 0);
+    ASSERT_TRUE(policy.selectVictims(candidates, {2, 0}).empty());
+
+    // The newcomer meets the least recently used admitted entry, not the
+    // least frequent one, and loses to it.
+    policy.recordAccess("old");
+    policy.recordAccess("old");
+    policy.recordAccess("new");
+    candidates.push_back({&keys[2], now, 0});
+    ASSERT_EQ(policy.selectVictims(candidates, {2, 0}), (std::vector<size_t> {2}));
+
+    // A more frequent newcomer is admitted in place of it.
+    for (int i = 0; i < 5; ++i) {
+        policy.recordAccess("new");
+    }
+    ASSERT_EQ(policy.selectVictims(candidates, {2, 0}), (std::vector<size_t> {0}));
+}
+
+TEST(EvictionPolicy, storageKeepsHotSetAfterScan) {
+    BaseParameters params;
+    params.path = "/tmp/binary_storage_test/tinyLfu";
+    params.cashSize = 4;
+    params.resizeCoeff = 1;
+    params.evictionPolicy = std::make_shared<TinyLfuPolicy>(1024);
+    std::filesystem::remove_all(params.path);
+
+    Storage<std::vector<int>> storage(params);
+    for (int round = 0; round < 3; ++round) {
+        for (int i = 0; i < 4; ++i) {
+            storage.store("hot" + std::to_string(i), std::vector<int>(10, i));
+        }
+    }
+
+    for (int i = 0; i < 20; ++i) {
+        storage.store("scan" + std::to_string(i), std::vector<int>(10, i));
+    }
+    storage.fitSize();
+
+    for (int i = 0; i < 4; ++i) {
+        ASSERT_FALSE(std::filesystem::exists(params.path + "/hot" + std::to_string(i) + ".bin"));
+    }
+    ASSERT_EQ(std::distance(std::filesystem::directory_iterator(params.path), {}), 20);
+}
@@ -0,0 +1,93 @@
+#include <gtest/gtest.h>
+
+#include <storage/Storage.hpp>
+#include <filesystem>
+
+#include "Test.Parameters.hpp"
+
+using namespace binary_storage::storage;
+
+TEST(FileLayout, keyEncoding) {
+    for (auto const& key: std::vector<std::string> {"plain-key_1", "a/b/../c", ".hidden", "with space", "%41", std::string("\0\xff", 2)}) {
+        auto const name = encodeKey(key);
+        ASSERT_EQ(name.find('/'), std::string::npos);
+        ASSERT_NE(name.front(), '.');
+        ASSERT_EQ(decodeKey(name), key);
+    }
+
+    ASSERT_EQ(encodeKey("plain-key_1.v2"), "plain-key_1.v2");
+    ASSERT_EQ(encodeKey("a/b"), "a%2Fb");
+    ASSERT_FALSE(decodeKey("bad%4").has_value());
+    ASSERT_FALSE(decodeKey("bad%zz").has_value());
+}
+
+TEST(FileLayout, keyLength) {
+    ASSERT_EQ(encodeKey(std::string(maxFileName, 'a')).size(), maxFileName);
+    ASSERT_EQ(encodeKey(std::string(maxFileName / 3, '/')).size(), maxFileName);
+    ASSERT_THROW(encodeKey(std::string(maxFileName / 3 + 1, '/')), std::logic_error);
+    ASSERT_THROW(encodeKey(std::string(maxFileName - 3, 'a'), 4), std::logic_error);
+
+    auto params = parameters("keyLength", 0);
+    params.encodeKeys = true;
+    Storage<std::vector<int>> storage(params);
+    auto const longest = std::string(maxFileName - params.extension.size() - 25, 'a');
+    storage.store(longest, {1});
+    storage.fitSize();
+    ASSERT_EQ(storage.load(longest), std::vector<int> {1});
+
+    ASSERT_THROW(storage.store(longest + 'a', {2}), std::logic_error);
+    ASSERT_THROW(storage.store(std::string(100, '/'), {3}), std::logic_error);
+    ASSERT_EQ(storage.size(), 1);
+}
+
+TEST(FileLayout, fanOutDirectory) {
+    ASSERT_EQ(fanOutDirectory("key", 0), "");
+    auto const directory = fanOutDirectory("key", 2);
+    ASSERT_EQ(directory.size(), 6);
+    ASSERT_EQ(directory, fanOutDirectory("key", 2));
+    ASSERT_EQ(directory.substr(0, 3), fanOutDirectory("key", 1));
+    ASSERT_LT(fanOutBucket("key", 2), 1 << 16);
+}
+
+TEST(FileLayout, storageFanOut) {
+    auto params = parameters("fanOut");
+    params.fanOutLevels = 2;
+    params.saveAllOnDestruct = true;
+
+    std::vector<std::string> keys;
+    for (int i = 0; i < 50; ++i) {
+        keys.push_back("user/" + std::to_string(i) + "/profile");
+    }
+    {
+        Storage<std::vector<int>> storage(params);
+        for (int i = 0; i < 50; ++i) {
+            storage.store(keys[i], std::vector<int>(i, i));
+        }
+        storage.fitSize();
+        ASSERT_EQ(storage.load(keys[7]), std::vector<int>(7, 7));
+        storage.erase(keys[8]);
+    }
+
+    size_t files = 0;
+    for (auto const& entry: std::filesystem::recursive_directory_iterator(params.path)) {
+        if (entry.is_regular_file()) {
+            ASSERT_EQ(entry.path().parent_path().parent_path().parent_path(), std::filesystem::path(params.path).parent_path());
+            ++files;
+        }
+    }
+    ASSERT_EQ(files, 49);
+
+    params.loadAllOnCreate = true;
+    params.ioThreads = 4;
+    {
+        Storage<std::vector<int>> storage(params);
+        ASSERT_EQ(storage.size(), 49);
+        ASSERT_EQ(storage.load(keys[42]), std::vector<int>(42, 42));
+        ASSERT_THROW(storage.load(keys[8]), std::logic_error);
+    }
+
+    params.useManifest = true;
+    Storage<std::vector<int>> storage(params);
+    ASSERT_EQ(storage.size(), 49);
+    ASSERT_EQ(storage.load(keys[3]), std::vector<int>(3, 3));
+}
@@ -0,0 +1,125 @@
+#include <gtest/gtest.h>
+
+#include <storage/KeyFilter.hpp>
+#include <storage/Storage.hpp>
+#include <algorithm>
+#include <cmath>
+#include <filesystem>
+#include <string>
+
+#include "Test.Parameters.hpp"
+
+using namespace binary_storage::storage;
+
+TEST(KeyFilter, noFalseNegatives) {
+    KeyFilter filter(10000, 10);
+    for (int i = 0; i < 10000; ++i) {
+        filter.add("key" + std::to_string(i));
+    }
+
+    size_t falsePositives = 0;
+    for (int i = 0; i < 10000; ++i) {
+        ASSERT_TRUE(filter.mayContain("key" + std::to_string(i)));
+        falsePositives += filter.mayContain("other" + std::to_string(i)) ? 1 : 0;
+    }
+    ASSERT_LT(falsePositives, 300);
+}
+
+TEST(KeyFilter, falsePositiveRate) {
+    size_t const keys = 10000;
+    size_t const probes = 100000;
+    for (size_t const bitsPerKey: {4, 8, 16}) {
+        KeyFilter filter(keys, bitsPerKey);
+        for (size_t i = 0; i < keys; ++i) {
+            filter.add("key" + std::to_string(i));
+        }
+
+        size_t falsePositives = 0;
+        for (size_t i = 0; i < probes; ++i) {
+            falsePositives += filter.mayContain("other" + std::to_string(i)) ? 1 : 0;
+        }
+
+        // The filter has at least bitsPerKey bits per key, so the rate of a
+        // Bloom filter with exactly that many bounds it.
+        auto const hashes = static_cast<double>(std::clamp<size_t>(bitsPerKey * 7 / 10, 1, 16));
+        auto const expected = std::pow(1 - std::exp(-hashes / static_cast<double>(bitsPerKey)), hashes);
+        ASSERT_LE(static_cast<double>(falsePositives) / probes, expected * 1.5 + 0.001) << bitsPerKey;
+    }
+}
+
+TEST(KeyFilter, manifestStartup) {
+    auto params = parameters("filterManifest");
+    params.useManifest = true;
+    params.loadAllOnCreate = true;
+    params.saveAllOnDestruct = true;
+    {
+        Storage<std::vector<int>> storage(params);
+        for (int i = 0; i < 100; ++i) {
+            storage.store("key" + std::to_string(i), {i});
+        }
+    }
+
+    Storage<std::vector<int>> storage(params);
+    ASSERT_FALSE(storage.contains("missing"));
+    ASSERT_EQ(storage.tryLoadConst("key7")->front(), 7);
+    ASSERT_TRUE(storage.contains("key99"));
+    storage.store("added", {1});
+    ASSERT_TRUE(storage.contains("added"));
+}
+
+TEST(KeyFilter, reopen) {
+    for (bool const manifest: {false, true}) {
+        auto params = parameters("filterReopen");
+        params.useManifest = manifest;
+        params.loadAllOnCreate = true;
+        params.saveAllOnDestruct = true;
+        {
+            Storage<std::vector<int>> storage(params);
+            for (int i = 0; i < 100; ++i) {
+                storage.store("key" + std::to_string(i), {i});
+            }
+        }
+
+        Storage<std::vector<int>> storage(params);
+        for (int i = 0; i < 100; ++i) {
+            ASSERT_TRUE(storage.contains("key" + std::to_string(i))) << i;
+        }
+        ASSERT_FALSE(storage.contains("missing"));
+        ASSERT_EQ(storage.tryLoadConst("missing"), nullptr);
+        ASSERT_EQ(storage.tryLoadConst("key42")->front(), 42);
+    }
+}
+
+TEST(KeyFilter, erase) {
+    auto const params = parameters("filterErase");
+    Storage<std::vector<int>> storage(params);
+    for (int i = 0; i < 100; ++i) {
+        storage.store("key" + std::to_string(i), {i});
+    }
+    storage.fitSize();
+
+    ASSERT_TRUE(storage.tryErase("key0"));
+    ASSERT_FALSE(storage.contains("key0"));
+    ASSERT_EQ(storage.tryLoadConst("key0"), nullptr);
+    ASSERT_FALSE(storage.tryErase("key0"));
+    storage.store("key0", {-1});
+    ASSERT_TRUE(storage.contains("key0"));
+
+    // Enough erases to rebuild the filter, which then leaves the erased keys out.
+    for (int round = 0; round < 5; ++round) {
+        for (int i = 1; i < 100; ++i) {
+            storage.erase("key" + std::to_string(i));
+            storage.store("key" + std::to_string(i), {round});
+        }
+    }
+    for (int i = 50; i < 100; ++i) {
+        storage.erase("key" + std::to_string(i));
+    }
+
+    for (int i = 0; i < 100; ++i) {
+        ASSERT_EQ(storage.contains("key" + std::to_string(i)), i < 50) << i;
+    }
+    ASSERT_EQ(storage.tryLoadConst("key0")->front(), -1);
+    ASSERT_EQ(storage.tryLoadConst("key49")->front(), 4);
+    ASSERT_EQ(storage.size(), 50);
+}
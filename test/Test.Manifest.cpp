@@ -0,0 +1,148 @@
+#include <gtest/gtest.h>
+
+#include <storage/Storage.hpp>
+#include <filesystem>
+#include <fstream>
+
+using namespace binary_storage::storage;
+
+static std::string directory(std::string const& name) {
+    auto const path = "/tmp/binary_storage_test/" + name + "/";
+    std::filesystem::remove_all(path);
+    std::filesystem::create_directories(path);
+    return path;
+}
+
+static std::vector<std::string> keys(Manifest const& manifest) {
+    std::vector<std::string> result;
+    manifest.forEach([&] (Manifest::Entry const& entry) { result.push_back(entry.key); });
+    return result;
+}
+
+TEST(Manifest, journalAndCheckpoint) {
+    auto const path = directory("manifestJournal");
+    auto const time = std::chrono::system_clock::now();
+    {
+        Manifest manifest(path);
+        manifest.put({"b", "b.bin", 10, time});
+        manifest.put({"a", "a.bin", 20, time});
+        manifest.checkpoint();
+        manifest.put({"c", "c.bin", 30, time});
+        manifest.erase("a");
+        manifest.put({"b", "b.bin", 40, time});
+    }
+
+    Manifest manifest(path);
+    ASSERT_EQ(manifest.count(), 2);
+    ASSERT_EQ(keys(manifest), (std::vector<std::string> {"b", "c"}));
+    ASSERT_FALSE(manifest.find("a").has_value());
+    ASSERT_EQ(manifest.find("b")->size, 40);
+    ASSERT_EQ(manifest.find("c")->lastAccess, time);
+
+    manifest.checkpoint();
+    ASSERT_EQ(manifest.journalSize(), 0);
+    ASSERT_EQ(manifest.count(), 2);
+    ASSERT_EQ(manifest.find("c")->location, "c.bin");
+}
+
+TEST(Manifest, storageRestart) {
+    BaseParameters params;
+    params.path = directory("manifestStorage");
+    params.cashSize = 4;
+    params.resizeCoeff = 2;
+    params.useManifest = true;
+    params.loadAllOnCreate = true;
+
+    std::chrono::system_clock::time_point evicted;
+    {
+        Storage<std::vector<int>> storage(params);
+        for (int i = 0; i < 10; ++i) {
+            storage.store(std::to_string(i), std::vector<int>(i, i));
+        }
+        storage.fitSize();
+        storage.erase("0");
+        evicted = Manifest(params.path).find("3")->lastAccess;
+    }
+
+    Storage<std::vector<int>> storage(params);
+    ASSERT_EQ(storage.size(), 7);
+    ASSERT_EQ(storage.load("5"), std::vector<int>(5, 5));
+    ASSERT_THROW(storage.load("0"), std::logic_error);
+    ASSERT_THROW(storage.load("9"), std::logic_error);
+
+    storage.store("1", {1});
+    storage.erase("2");
+    ASSERT_EQ(storage.size(), 6);
+    ASSERT_EQ(Manifest(params.path).find("3")->lastAccess, evicted);
+}
+
+TEST(Manifest, buildFromDirectory) {
+    BaseParameters params;
+    params.path = directory("manifestBuild");
+    params.saveAllOnDestruct = true;
+    {
+        Storage<std::vector<int>> storage(params);
+        storage.store("x", {1});
+        storage.store("y", {2, 2});
+    }
+
+    params.useManifest = true;
+    params.loadAllOnCreate = true;
+    {
+        Storage<std::vector<int>> storage(params);
+        ASSERT_EQ(storage.size(), 2);
+        ASSERT_EQ(storage.load("y"), (std::vector<int> {2, 2}));
+    }
+
+    Manifest manifest(params.path);
+    ASSERT_EQ(keys(manifest), (std::vector<std::string> {"x", "y"}));
+}
+
+// Points the key of the first checkpoint record past the end of the file.
+static void corruptCheckpoint(std::string const& path) {
+    uint64_t const offset = uint64_t {1} << 40;
+    std::fstream file(path + "manifest.idx", std::ios::binary | std::ios::in | std::ios::out);
+    file.seekp(16);
+    file.write(reinterpret_cast<char const*>(&offset), sizeof(offset));
+}
+
+TEST(Manifest, corruptCheckpoint) {
+    auto const path = directory("manifestCorrupt");
+    auto const time = std::chrono::system_clock::now();
+    {
+        Manifest manifest(path);
+        manifest.put({"a", "a.bin", 10, time});
+        manifest.put({"b", "b.bin", 20, time});
+        manifest.checkpoint();
+        manifest.put({"c", "c.bin", 30, time});
+    }
+    corruptCheckpoint(path);
+
+    Manifest manifest(path);
+    ASSERT_TRUE(manifest.rejected());
+    ASSERT_EQ(keys(manifest), std::vector<std::string> {"c"});
+    ASSERT_FALSE(manifest.find("a").has_value());
+    ASSERT_EQ(manifest.count(), 1);
+}
+
+TEST(Manifest, storageRebuildsCorruptCheckpoint) {
+    BaseParameters params;
+    params.path = directory("manifestCorruptStorage");
+    params.saveAllOnDestruct = true;
+    params.useManifest = true;
+    params.loadAllOnCreate = true;
+    {
+        Storage<std::vector<int>> storage(params);
+        for (int i = 0; i < 10; ++i) {
+            storage.store(std::to_string(i), std::vector<int>(i, i));
+        }
+    }
+    corruptCheckpoint(params.path);
+
+    {
+        Storage<std::vector<int>> storage(params);
+        ASSERT_EQ(storage.size(), 10);
+        ASSERT_EQ(storage.load("5"), std::vector<int>(5, 5));
+    }
+    ASSERT_FALSE(Manifest(params.path).rejected());
+}
@@ -0,0 +1,19 @@
+#pragma once
+
+#include <storage/Parameters.hpp>
+#include <chrono>
+#include <filesystem>
+#include <string>
+
+// Parameters of a test storage in its own empty directory. The cache is kept
+// small, so a few values are enough to evict, and expiry ticks are short, so
+// TTL tests sleep for milliseconds.
+inline binary_storage::storage::BaseParameters parameters(std::string const& name, size_t cashSize = 4) {
+    binary_storage::storage::BaseParameters params;
+    params.path = "/tmp/binary_storage_test/" + name + "/";
+    params.cashSize = cashSize;
+    params.resizeCoeff = 2;
+    params.ttlResolution = std::chrono::milliseconds {5};
+    std::filesystem::remove_all(params.path);
+    return params;
+}
@@ -0,0 +1,51 @@
+#include <gtest/gtest.h>
+
+#include <storage/ReadIndex.hpp>
+
+using namespace binary_storage::storage;
+
+static std::optional<int> find(ReadIndex<int> const& index, std::string const& key) {
+    std::optional<int> result;
+    index.visit(key, [&result] (int value) { result = value; });
+    return result;
+}
+
+TEST(ReadIndex, publishAndUnpublish) {
+    ReadIndex<int> index(4);
+    auto const always = [] { return true; };
+    for (int i = 0; i < 20; ++i) {
+        ASSERT_TRUE(index.publish(std::to_string(i), std::make_shared<int const>(i), always));
+    }
+    ASSERT_FALSE(index.publish("stale", std::make_shared<int const>(0), [] { return false; }));
+
+    ASSERT_EQ(index.size(), 20);
+    ASSERT_EQ(find(index, "7"), 7);
+    ASSERT_FALSE(find(index, "stale").has_value());
+
+    index.publish("7", std::make_shared<int const>(70), always);
+    index.unpublish("8");
+    ASSERT_EQ(find(index, "7"), 70);
+    ASSERT_FALSE(find(index, "8").has_value());
+    ASSERT_EQ(index.size(), 19);
+
+    index.clear();
+    ASSERT_EQ(index.size(), 0);
+    ASSERT_FALSE(find(index, "7").has_value());
+}
+
+TEST(ReadIndex, reclaimWaitsForReaders) {
+    ReadIndex<int> index(1);
+    auto const always = [] { return true; };
+    index.publish("key", std::make_shared<int const>(0), always);
+
+    index.visit("key", [&] (int value) {
+        for (int i = 1; i <= 100; ++i) {
+            index.publish("key", std::make_shared<int const>(i), always);
+        }
+        ASSERT_EQ(value, 0);
+        ASSERT_EQ(index.retiredCount(), 100);
+    });
+
+    index.publish("key", std::make_shared<int const>(0), always);
+    ASSERT_LT(index.retiredCount(), 64);
+}
@@ -0,0 +1,144 @@
+#include <gtest/gtest.h>
+
+#include <storage/Storage.hpp>
+#include <filesystem>
+#include <fstream>
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+using namespace binary_storage::storage;
+
+static std::string segment(std::string const& name) {
+    auto const segmentName = "binary_storage_test_" + name;
+    SharedSegment::remove(segmentName);
+    return segmentName;
+}
+
+TEST(SharedSegment, putGet) {
+    auto const name = segment("putGet");
+    SharedSegment shared(name, 1 << 20);
+    SharedSegment::Stamp const stamp {1, 5, 10};
+    ASSERT_TRUE(shared.put("key", stamp, "value"));
+    ASSERT_EQ(shared.get("key", stamp), "value");
+    ASSERT_FALSE(shared.get("key", SharedSegment::Stamp {1, 5, 11}).has_value());
+    ASSERT_FALSE(shared.get("other", stamp).has_value());
+
+    SharedSegment other(name, 1 << 20);
+    ASSERT_EQ(other.get("key", stamp), "value");
+    ASSERT_TRUE(other.put("key", stamp, "changed"));
+    ASSERT_EQ(shared.get("key", stamp), "changed");
+    ASSERT_EQ(shared.count(), 1);
+    SharedSegment::remove(name);
+}
+
+TEST(SharedSegment, ringOverwritesOldest) {
+    auto const name = segment("ring");
+    SharedSegment shared(name, 1 << 20);
+    std::string const bytes(100000, 'x');
+    for (int i = 0; i < 30; ++i) {
+        ASSERT_TRUE(shared.put(std::to_string(i), {}, bytes));
+    }
+
+    ASSERT_LT(shared.count(), 30);
+    ASSERT_FALSE(shared.get("0", {}).has_value());
+    ASSERT_EQ(shared.get("29", {}), bytes);
+    ASSERT_FALSE(shared.put("huge", {}, std::string(2 << 20, 'x')));
+    SharedSegment::remove(name);
+}
+
+TEST(SharedSegment, eraseBumpsGeneration) {
+    auto const name = segment("erase");
+    SharedSegment shared(name, 1 << 20);
+    auto const generation = shared.generation();
+    ASSERT_TRUE(shared.put("key", {}, "old", generation));
+
+    shared.erase("key");
+    ASSERT_FALSE(shared.get("key", {}).has_value());
+    ASSERT_EQ(shared.count(), 0);
+    ASSERT_FALSE(shared.put("key", {}, "old", generation));
+    ASSERT_FALSE(shared.get("key", {}).has_value());
+    ASSERT_TRUE(shared.put("key", {}, "new", shared.generation()));
+    ASSERT_EQ(shared.get("key", {}), "new");
+    SharedSegment::remove(name);
+}
+
+TEST(SharedSegment, rejectsCorruptHeader) {
+    auto const name = segment("corrupt");
+    {
+        SharedSegment shared(name, 1 << 20);
+        ASSERT_TRUE(shared.put("key", {}, "value"));
+    }
+
+    uint64_t const slots = 1 << 30;
+    std::fstream file("/dev/shm/" + name, std::ios::binary | std::ios::in | std::ios::out);
+    file.seekp(8);
+    file.write(reinterpret_cast<char const*>(&slots), sizeof(slots));
+    file.close();
+
+    ASSERT_THROW(SharedSegment(name, 1 << 20), std::logic_error);
+    SharedSegment::remove(name);
+}
+
+TEST(SharedSegment, acrossProcesses) {
+    auto const name = segment("processes");
+    SharedSegment shared(name, 1 << 20);
+    auto const child = fork();
+    if (child == 0) {
+        SharedSegment segment(name, 1 << 20);
+        segment.put("child", {}, "written by child");
+        _exit(0);
+    }
+
+    int status = 0;
+    ASSERT_EQ(waitpid(child, &status, 0), child);
+    ASSERT_EQ(shared.get("child", {}), "written by child");
+    SharedSegment::remove(name);
+}
+
+TEST(SharedSegment, storagesShareReloads) {
+    BaseParameters params;
+    params.path = "/tmp/binary_storage_test/sharedStorage/";
+    params.saveAllOnDestruct = true;
+    std::filesystem::remove_all(params.path);
+    {
+        Storage<std::vector<int>> storage(params);
+        storage.store("a", {1, 2, 3});
+        storage.store("b", {4});
+    }
+
+    params.loadAllOnCreate = true;
+    params.saveAllOnDestruct = false;
+    params.sharedMemoryName = segment("storage");
+    Storage<std::vector<int>> first(params);
+    Storage<std::vector<int>> second(params);
+    ASSERT_EQ(first.loadConst("a"), (std::vector<int> {1, 2, 3}));
+
+    SharedSegment shared(params.sharedMemoryName, params.sharedMemoryBytes);
+    auto const path = params.path + "a.bin";
+    auto const stamp = SharedSegment::fileStamp(path);
+    ASSERT_EQ(shared.count(), 1);
+    ASSERT_EQ(shared.get(path, *stamp), encodeValue(std::vector<int> {1, 2, 3}));
+
+    shared.put(path, *stamp, encodeValue(std::vector<int> {9}));
+    ASSERT_EQ(second.loadConst("a"), std::vector<int> {9});
+
+    {
+        Storage<std::vector<int>> writer(params);
+        writer.store("a", {7});
+        writer.flush().wait();
+    }
+    Storage<std::vector<int>> third(params);
+    ASSERT_EQ(third.loadConst("a"), std::vector<int> {7});
+
+    {
+        auto inPlace = params;
+        inPlace.cashSize = 0;
+        Storage<std::vector<int>> writer(inPlace);
+        writer.store("a", {8});
+        writer.fitSize();
+    }
+    Storage<std::vector<int>> fourth(params);
+    ASSERT_EQ(fourth.loadConst("a"), std::vector<int> {8});
+    SharedSegment::remove(params.sharedMemoryName);
+}
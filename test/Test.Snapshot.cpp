@@ -0,0 +1,194 @@
+#include <gtest/gtest.h>
+
+#include <storage/Storage.hpp>
+#include <filesystem>
+#include <fstream>
+
+#include "Test.Parameters.hpp"
+
+using namespace binary_storage::storage;
+
+TEST(Snapshot, isolation) {
+    Storage<std::vector<int>> storage(parameters("snapshotIsolation"));
+    storage.store("a", {1});
+    storage.store("b", {2});
+    storage.store("c", {3});
+
+    {
+        auto const snapshot = storage.snapshot();
+        storage.store("a", {10});
+        storage.erase("b");
+        storage.load("c").push_back(30);
+        storage.store("d", {4});
+
+        ASSERT_EQ(snapshot.load("a"), std::vector<int> {1});
+        ASSERT_EQ(snapshot.load("b"), std::vector<int> {2});
+        ASSERT_EQ(snapshot.load("c"), std::vector<int> {3});
+        ASSERT_FALSE(snapshot.contains("d"));
+        ASSERT_THROW(snapshot.load("d"), std::logic_error);
+        ASSERT_EQ(snapshot.keys(), (std::vector<std::string> {"a", "b", "c"}));
+
+        auto const next = storage.snapshot();
+        ASSERT_EQ(next.load("a"), std::vector<int> {10});
+        ASSERT_FALSE(next.contains("b"));
+        ASSERT_EQ(next.load("c"), (std::vector<int> {3, 30}));
+        ASSERT_EQ(next.keys(), (std::vector<std::string> {"a", "c", "d"}));
+    }
+
+    ASSERT_EQ(storage.loadConst("c"), (std::vector<int> {3, 30}));
+    ASSERT_THROW(storage.load("b"), std::logic_error);
+}
+
+TEST(Snapshot, evictedVersions) {
+    auto const params = parameters("snapshotEvicted");
+    Storage<std::vector<int>> storage(params);
+    for (int i = 0; i < 8; ++i) {
+        storage.store(std::to_string(i), std::vector<int>(i, i));
+    }
+    storage.fitSize();
+
+    {
+        auto const snapshot = storage.snapshot();
+        for (int i = 0; i < 8; ++i) {
+            storage.store(std::to_string(i), {-i});
+        }
+        storage.fitSize();
+
+        for (int i = 0; i < 8; ++i) {
+            ASSERT_EQ(snapshot.load(std::to_string(i)), std::vector<int>(i, i));
+        }
+        ASSERT_FALSE(std::filesystem::is_empty(params.path + "snapshots/"));
+    }
+
+    ASSERT_TRUE(std::filesystem::is_empty(params.path + "snapshots/"));
+    for (int i = 0; i < 8; ++i) {
+        ASSERT_EQ(storage.loadConst(std::to_string(i)), std::vector<int> {-i});
+    }
+}
+
+TEST(Snapshot, toDisk) {
+    auto const params = parameters("snapshotToDisk");
+    Storage<std::vector<int>> storage(params);
+    for (int i = 0; i < 6; ++i) {
+        storage.store(std::to_string(i), std::vector<int>(i, i));
+    }
+    storage.fitSize();
+
+    auto const path = params.path + "snapshot.archive";
+    ASSERT_EQ(storage.snapshotToDisk(path), 6);
+
+    std::ifstream stream(path, std::ios::binary);
+    auto const header = archive::readHeader(stream);
+    ASSERT_TRUE(header.has_value());
+    ASSERT_EQ(header->entries, 6);
+    ASSERT_EQ(header->layout, archive::layoutOf<std::vector<int>>({}));
+    std::vector<std::string> keys;
+    while (auto entry = archive::readEntry(stream)) {
+        auto const value = decodeValue<std::vector<int>>(entry->second);
+        ASSERT_TRUE(value.has_value());
+        ASSERT_EQ(*value, std::vector<int>(value->size(), static_cast<int>(value->size())));
+        keys.push_back(entry->first);
+    }
+    ASSERT_EQ(keys, (std::vector<std::string> {"0", "1", "2", "3", "4", "5"}));
+}
+
+TEST(Snapshot, exportImport) {
+    auto const params = parameters("exportImport");
+    auto const path = "/tmp/binary_storage_test/exportImport.archive";
+    {
+        Storage<std::vector<int>> storage(params);
+        for (int i = 0; i < 50; ++i) {
+            storage.store("key" + std::to_string(i), std::vector<int>(i, i));
+        }
+        storage.fitSize();
+        ASSERT_EQ(storage.exportTo(path), 50);
+    }
+
+    for (size_t const threads: {1, 4}) {
+        auto target = parameters("exportImportTarget");
+        target.useManifest = threads > 1;
+        target.saveAllOnDestruct = true;
+        {
+            Storage<std::vector<int>> storage(target);
+            storage.store("key7", {-1});
+            storage.store("other", {1, 2});
+            auto const snapshot = storage.snapshot();
+
+            ASSERT_EQ(storage.importFrom(path, threads), 50);
+            ASSERT_EQ(storage.size(), 51);
+            ASSERT_EQ(storage.load("key7"), std::vector<int>(7, 7));
+            ASSERT_EQ(storage.load("key49"), std::vector<int>(49, 49));
+            ASSERT_EQ(storage.load("other"), (std::vector<int> {1, 2}));
+            ASSERT_EQ(snapshot.load("key7"), std::vector<int> {-1});
+            ASSERT_FALSE(snapshot.contains("key8"));
+        }
+
+        target.loadAllOnCreate = true;
+        Storage<std::vector<int>> reopened(target);
+        ASSERT_EQ(reopened.size(), 51);
+        ASSERT_EQ(reopened.load("key30"), std::vector<int>(30, 30));
+    }
+
+    std::ofstream(params.path + "broken.archive") << "not an archive";
+    Storage<std::vector<int>> storage(params);
+    ASSERT_THROW(storage.importFrom(params.path + "broken.archive"), std::logic_error);
+}
+
+TEST(Snapshot, mismatchedImport) {
+    auto const params = parameters("mismatchedImport");
+    auto const path = "/tmp/binary_storage_test/mismatchedImport.archive";
+    {
+        Storage<std::vector<int>> storage(params);
+        storage.store("a", {1, 2, 3});
+        ASSERT_EQ(storage.exportTo(path), 1);
+    }
+
+    auto chunked = parameters("mismatchedImportChunked");
+    chunked.chunkElements = 2;
+    Storage<std::vector<int>> chunkedStorage(chunked);
+    ASSERT_THROW(chunkedStorage.importFrom(path), std::logic_error);
+    ASSERT_EQ(chunkedStorage.size(), 0);
+
+    Storage<std::vector<double>> otherType(parameters("mismatchedImportType"));
+    ASSERT_THROW(otherType.importFrom(path), std::logic_error);
+    ASSERT_EQ(otherType.size(), 0);
+
+    // An archive without the layout, as the earlier format wrote them.
+    auto const unversioned = "/tmp/binary_storage_test/mismatchedImportUnversioned.archive";
+    {
+        std::ofstream stream(unversioned, std::ios::binary);
+        binary_storage::serde::serialize(stream, archive::magic);
+        binary_storage::serde::serialize(stream, uint32_t {2});
+        binary_storage::serde::serialize(stream, uint64_t {0});
+        archive::writeEnd(stream);
+    }
+    Storage<std::vector<int>> unversionedStorage(parameters("mismatchedImportUnversioned"));
+    ASSERT_THROW(unversionedStorage.importFrom(unversioned), std::logic_error);
+
+    Storage<std::vector<int>> same(parameters("mismatchedImportSame"));
+    ASSERT_EQ(same.importFrom(path), 1);
+    ASSERT_EQ(same.load("a"), (std::vector<int> {1, 2, 3}));
+}
+
+TEST(Snapshot, failedImport) {
+    auto const params = parameters("failedImport");
+    auto const path = "/tmp/binary_storage_test/failedImport.archive";
+    {
+        Storage<std::vector<int>> storage(params);
+        storage.store("a", {1, 2, 3});
+        storage.store("b", {4});
+        ASSERT_EQ(storage.exportTo(path), 2);
+    }
+
+    auto const target = parameters("failedImportTarget");
+    Storage<std::vector<int>> storage(target);
+    storage.store("a", {-1});
+    auto const resident = storage.residentBytes();
+    std::filesystem::create_directories(target.path + "b.bin.import");
+
+    ASSERT_THROW(storage.importFrom(path), std::logic_error);
+    ASSERT_EQ(storage.size(), 1);
+    ASSERT_EQ(storage.residentBytes(), resident);
+    ASSERT_EQ(storage.load("a"), std::vector<int> {-1});
+    ASSERT_FALSE(std::filesystem::exists(target.path + "a.bin.import"));
+}
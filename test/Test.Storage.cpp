@@ -0,0 +1,548 @@
+#include <gtest/gtest.h>
+
+#include <storage/Storage.hpp>
+#include <serde/footprint.hpp>
+#include <deque>
+#include <filesystem>
+#include <fstream>
+#include <list>
+#include <thread>
+
+#include "Test.Parameters.hpp"
+
+using namespace binary_storage::storage;
+
+struct StorageValue {
+    uint32_t id {0};
+    std::string name;
+    std::vector<double> samples;
+};
+
+REFL_AUTO(
+    type(StorageValue),
+    field(id),
+    field(name),
+    field(samples)
+)
+
+static StorageValue makeValue(uint32_t id) {
+    return {id, "value" + std::to_string(id), std::vector<double>(id, 0.5)};
+}
+
+static size_t filesCount(std::string const& path) {
+    return static_cast<size_t>(std::distance(std::filesystem::directory_iterator(path), {}));
+}
+
+TEST(Storage, storeLoad) {
+    Storage<StorageValue> storage(parameters("storeLoad"));
+    for (uint32_t i = 0; i < 10; ++i) {
+        storage.store(std::to_string(i), makeValue(i));
+    }
+
+    ASSERT_EQ(storage.size(), 10);
+    ASSERT_EQ(storage.load("7").name, "value7");
+    ASSERT_THROW(storage.load("missing"), std::logic_error);
+
+    storage.erase("7");
+    ASSERT_EQ(storage.size(), 9);
+}
+
+TEST(Storage, fitSize) {
+    auto params = parameters("fitSize");
+    Storage<StorageValue> storage(params);
+    for (uint32_t i = 0; i < 10; ++i) {
+        storage.store(std::to_string(i), makeValue(i));
+    }
+
+    storage.fitSize();
+    ASSERT_EQ(filesCount(params.path), 8);
+
+    for (uint32_t i = 0; i < 10; ++i) {
+        ASSERT_EQ(storage.load(std::to_string(i)).samples.size(), i);
+    }
+}
+
+TEST(Storage, fitSizeAsync) {
+    auto params = parameters("fitSizeAsync");
+    Storage<StorageValue> storage(params);
+    for (uint32_t i = 0; i < 10; ++i) {
+        storage.store(std::to_string(i), makeValue(i));
+    }
+
+    storage.fitSizeAsync().get();
+    ASSERT_EQ(filesCount(params.path), 8);
+
+    std::vector<std::string> keys;
+    for (uint32_t i = 0; i < 10; ++i) {
+        keys.push_back(std::to_string(i));
+    }
+    storage.prefetch(keys).get();
+
+    for (uint32_t i = 0; i < 10; ++i) {
+        ASSERT_EQ(storage.load(std::to_string(i)).id, i);
+    }
+    ASSERT_THROW(storage.prefetch({"missing"}), std::logic_error);
+}
+
+TEST(Storage, saveAllOnDestruct) {
+    auto params = parameters("saveAllOnDestruct");
+    params.saveAllOnDestruct = true;
+    {
+        Storage<StorageValue> storage(params);
+        for (uint32_t i = 0; i < 3; ++i) {
+            storage.store(std::to_string(i), makeValue(i));
+        }
+    }
+
+    params.loadAllOnCreate = true;
+    Storage<StorageValue> storage(params);
+    ASSERT_EQ(storage.size(), 3);
+    ASSERT_EQ(storage.load("2").name, "value2");
+}
+
+TEST(Storage, serializedTier) {
+    auto params = parameters("serializedTier");
+    params.serializedCacheSize = 1 << 20;
+    params.compressSerialized = true;
+    Storage<StorageValue> storage(params);
+    for (uint32_t i = 0; i < 10; ++i) {
+        storage.store(std::to_string(i), makeValue(i * 100));
+    }
+
+    storage.fitSize();
+    ASSERT_EQ(filesCount(params.path), 0);
+    ASSERT_GT(storage.serializedBytes(), 0);
+
+    for (uint32_t i = 0; i < 10; ++i) {
+        ASSERT_EQ(storage.load(std::to_string(i)).samples.size(), i * 100);
+    }
+    ASSERT_EQ(storage.serializedBytes(), 0);
+}
+
+TEST(Storage, serializedTierSpill) {
+    auto params = parameters("serializedTierSpill");
+    params.serializedCacheSize = 2000;
+    Storage<StorageValue> storage(params);
+    for (uint32_t i = 0; i < 10; ++i) {
+        storage.store(std::to_string(i), makeValue(100));
+    }
+
+    storage.fitSizeAsync().get();
+    ASSERT_LE(storage.serializedBytes(), params.serializedCacheSize);
+    ASSERT_GT(storage.serializedBytes(), 0);
+    ASSERT_GT(filesCount(params.path), 0);
+
+    storage.erase("0");
+    storage.flush().get();
+    ASSERT_EQ(filesCount(params.path), 9);
+    for (uint32_t i = 1; i < 10; ++i) {
+        ASSERT_EQ(storage.load(std::to_string(i)).name, "value100");
+    }
+}
+
+TEST(Storage, loadFields) {
+    auto params = parameters("loadFields");
+    params.serializedCacheSize = 1000;
+    Storage<StorageValue> storage(params);
+    for (uint32_t i = 0; i < 10; ++i) {
+        storage.store(std::to_string(i), makeValue(100 + i));
+    }
+    storage.fitSize();
+
+    for (uint32_t i = 0; i < 10; ++i) {
+        auto const [id, name] = storage.loadFields<&StorageValue::id, &StorageValue::name>(std::to_string(i));
+        ASSERT_EQ(id, 100 + i);
+        ASSERT_EQ(name, "value" + std::to_string(100 + i));
+    }
+
+    auto const files = filesCount(params.path);
+    auto const serialized = storage.serializedBytes();
+    ASSERT_GT(files, 0);
+    ASSERT_GT(serialized, 0);
+    ASSERT_EQ(std::get<0>(storage.loadFields<&StorageValue::samples>("0")).size(), 100);
+    ASSERT_EQ(storage.serializedBytes(), serialized);
+    ASSERT_THROW(storage.loadFields<&StorageValue::id>("missing"), std::logic_error);
+}
+
+TEST(Storage, loadSlice) {
+    auto params = parameters("loadSlice");
+    params.cashSize = 1;
+    params.chunkElements = 100;
+    Storage<std::vector<double>> storage(params);
+    for (int i = 0; i < 4; ++i) {
+        std::vector<double> series(1000);
+        for (size_t j = 0; j < series.size(); ++j) {
+            series[j] = i * 1000.0 + j;
+        }
+        storage.store(std::to_string(i), std::move(series));
+    }
+
+    storage.fitSize();
+    ASSERT_EQ(filesCount(params.path), 4);
+
+    auto const slice = storage.loadSlice("1", 250, 260);
+    ASSERT_EQ(slice.size(), 10);
+    ASSERT_EQ(slice.front(), 1250.0);
+    ASSERT_EQ(slice.back(), 1259.0);
+    ASSERT_EQ(storage.loadSlice("2", 995, 2000).size(), 5);
+    ASSERT_EQ(storage.load("3")[999], 3999.0);
+    ASSERT_EQ(storage.loadSlice("3", 10, 12), (std::vector<double> {3010.0, 3011.0}));
+}
+
+TEST(Storage, parallelSerde) {
+    auto params = parameters("parallelSerde");
+    params.cashSize = 1;
+    params.chunkElements = 100;
+    params.serdeThreads = 4;
+    params.saveAllOnDestruct = true;
+    {
+        Storage<std::vector<double>> storage(params);
+        for (int i = 0; i < 4; ++i) {
+            std::vector<double> series(1050);
+            for (size_t j = 0; j < series.size(); ++j) {
+                series[j] = i * 10000.0 + j;
+            }
+            storage.store(std::to_string(i), std::move(series));
+        }
+
+        storage.fitSize();
+        ASSERT_EQ(storage.load("1")[1049], 11049.0);
+        storage.load("2")[7] = -1.0;
+    }
+
+    params.serdeThreads = 0;
+    params.loadAllOnCreate = true;
+    Storage<std::vector<double>> storage(params);
+    ASSERT_EQ(storage.load("2")[7], -1.0);
+    ASSERT_EQ(storage.load("3").size(), 1050);
+    ASSERT_EQ(storage.loadSlice("0", 520, 522), (std::vector<double> {520.0, 521.0}));
+}
+
+TEST(Storage, loadColumns) {
+    for (bool const columnar: {false, true}) {
+        auto params = parameters("loadColumns");
+        params.cashSize = 1;
+        params.columnar = columnar;
+        Storage<std::vector<StorageValue>> storage(params);
+        for (uint32_t i = 0; i < 3; ++i) {
+            std::vector<StorageValue> records;
+            for (uint32_t j = 0; j < 20; ++j) {
+                records.push_back(makeValue(i * 100 + j));
+            }
+            storage.store(std::to_string(i), std::move(records));
+        }
+
+        auto const resident = storage.loadColumns<&StorageValue::id>("2");
+        storage.fitSize();
+        ASSERT_EQ(filesCount(params.path), 3);
+
+        auto const [ids, names] = storage.loadColumns<&StorageValue::id, &StorageValue::name>("1");
+        ASSERT_EQ(ids.size(), 20);
+        ASSERT_EQ(ids[5], 105);
+        ASSERT_EQ(names[5], "value105");
+        ASSERT_EQ(std::get<0>(resident), std::get<0>(storage.loadColumns<&StorageValue::id>("2")));
+        ASSERT_EQ(storage.load("0")[19].samples.size(), 19);
+    }
+}
+
+TEST(Storage, cleanEviction) {
+    for (bool const async: {false, true}) {
+        auto params = parameters("cleanEviction");
+        params.cashSize = 1;
+        params.resizeCoeff = 100;
+        Storage<StorageValue> storage(params);
+        storage.store("read", makeValue(1));
+        storage.store("written", makeValue(2));
+        storage.fitSize();
+        ASSERT_EQ(filesCount(params.path), 2);
+
+        ASSERT_EQ(storage.loadConst("read").id, 1);
+        storage.load("written").name = "changed";
+        std::filesystem::remove(params.path + "read.bin");
+        std::filesystem::remove(params.path + "written.bin");
+
+        if (async) {
+            storage.fitSizeAsync().get();
+        } else {
+            storage.fitSize();
+        }
+        ASSERT_EQ(filesCount(params.path), 1);
+        ASSERT_EQ(storage.loadConst("written").name, "changed");
+    }
+}
+
+TEST(Storage, changeAfterFlush) {
+    auto params = parameters("changeAfterFlush");
+    params.cashSize = 0;
+    Storage<std::vector<int>> storage(params);
+    storage.store("a", {1});
+
+    auto& value = storage.load("a");
+    storage.flush().wait();
+    value.push_back(2);
+    storage.fitSize();
+    ASSERT_EQ(storage.loadConst("a"), (std::vector<int> {1, 2}));
+
+    std::filesystem::remove(params.path + "a.bin");
+    storage.fitSize();
+    ASSERT_FALSE(std::filesystem::exists(params.path + "a.bin"));
+}
+
+TEST(Storage, failedEviction) {
+    auto const params = parameters("failedEviction", 0);
+    Storage<std::vector<int>> storage(params);
+    std::filesystem::create_directories(params.path + "a.bin");
+    storage.store("a", {1});
+
+    ASSERT_THROW(storage.fitSize(), std::logic_error);
+    ASSERT_EQ(storage.loadConst("a"), std::vector<int> {1});
+    ASSERT_THROW(storage.fitSize(), std::logic_error);
+
+    std::filesystem::remove(params.path + "a.bin");
+    storage.fitSize();
+    ASSERT_EQ(storage.residentBytes(), 0);
+    ASSERT_EQ(storage.loadConst("a"), std::vector<int> {1});
+}
+
+TEST(Storage, engineWriteOrder) {
+    auto params = parameters("engineWriteOrder");
+    params.cashSize = 0;
+    params.diskEngine = DiskEngineKind::ThreadPool;
+    params.ioThreads = 1;
+    Storage<std::vector<int>> storage(params);
+    for (int i = 0; i < 8; ++i) {
+        storage.store("a", std::vector<int>(1 << 21, i));
+        auto flushed = storage.flush();
+        storage.store("a", {-i});
+        storage.fitSize();
+        flushed.get();
+
+        ASSERT_EQ(storage.loadConst("a"), std::vector<int> {-i});
+        storage.fitSize();
+    }
+    ASSERT_EQ(filesCount(params.path), 1);
+}
+
+TEST(Storage, lockFreeReads) {
+    auto params = parameters("lockFreeReads");
+    params.lockFreeReads = true;
+    Storage<StorageValue> storage(params);
+    for (uint32_t i = 0; i < 10; ++i) {
+        storage.store(std::to_string(i), makeValue(i));
+    }
+    storage.fitSize();
+
+    for (uint32_t i = 0; i < 10; ++i) {
+        ASSERT_EQ(storage.read(std::to_string(i)).samples.size(), i);
+    }
+
+    storage.read("9", [] (StorageValue const& value) { ASSERT_EQ(value.id, 9); });
+    storage.load("9").name = "changed";
+    ASSERT_EQ(storage.read("9").name, "changed");
+    storage.store("9", makeValue(90));
+    ASSERT_EQ(storage.read("9").id, 90);
+    storage.erase("9");
+    ASSERT_THROW(storage.read("9"), std::logic_error);
+}
+
+TEST(Storage, lockFreeReadsConcurrentStores) {
+    auto params = parameters("lockFreeReadsConcurrent");
+    params.lockFreeReads = true;
+    params.cashSize = 16;
+    Storage<std::vector<uint32_t>> storage(params);
+    for (uint32_t i = 0; i < 8; ++i) {
+        storage.store(std::to_string(i), std::vector<uint32_t>(16, 0));
+    }
+
+    std::atomic<bool> consistent {true};
+    std::vector<std::thread> readers;
+    for (size_t t = 0; t < 4; ++t) {
+        readers.emplace_back([&storage, &consistent, t] {
+            for (uint32_t i = 0; i < 20000; ++i) {
+                storage.read(std::to_string((i + t) % 8), [&consistent] (std::vector<uint32_t> const& value) {
+                    if (std::count(value.begin(), value.end(), value.front()) != 16) {
+                        consistent = false;
+                    }
+                });
+            }
+        });
+    }
+
+    for (uint32_t i = 1; i <= 2000; ++i) {
+        storage.store(std::to_string(i % 8), std::vector<uint32_t>(16, i));
+    }
+    for (auto& reader: readers) {
+        reader.join();
+    }
+
+    ASSERT_TRUE(consistent);
+    ASSERT_EQ(storage.read("0"), std::vector<uint32_t>(16, 2000));
+}
+
+TEST(Storage, tryLoadContainsTryErase) {
+    for (size_t const bits: {0, 10}) {
+        auto params = parameters("tryLoad");
+        params.keyFilterBits = bits;
+        Storage<StorageValue> storage(params);
+        for (uint32_t i = 0; i < 200; ++i) {
+            storage.store(std::to_string(i), makeValue(i));
+        }
+        storage.fitSize();
+
+        for (uint32_t i = 0; i < 200; ++i) {
+            ASSERT_TRUE(storage.contains(std::to_string(i)));
+            ASSERT_EQ(storage.tryLoadConst(std::to_string(i))->id, i);
+        }
+        ASSERT_FALSE(storage.contains("missing"));
+        ASSERT_EQ(storage.tryLoad("missing"), nullptr);
+        ASSERT_FALSE(storage.tryErase("missing"));
+
+        ASSERT_TRUE(storage.tryErase("7"));
+        ASSERT_FALSE(storage.tryErase("7"));
+        ASSERT_FALSE(storage.contains("7"));
+        ASSERT_EQ(storage.tryLoad("7"), nullptr);
+        ASSERT_THROW(storage.load("7"), std::logic_error);
+
+        storage.clear();
+        ASSERT_FALSE(storage.contains("8"));
+        storage.store("8", makeValue(8));
+        ASSERT_EQ(storage.tryLoad("8")->id, 8);
+    }
+}
+
+TEST(Storage, appendAndPatch) {
+    auto params = parameters("appendAndPatch");
+    params.cashSize = 0;
+    auto const& directory = params.path;
+    {
+        Storage<std::vector<int>> storage(params);
+        storage.store("a", std::vector<int>(100, 1));
+        storage.store("b", {1, 2, 3});
+        storage.fitSize();
+
+        auto const fileSize = std::filesystem::file_size(directory + "a.bin");
+        ASSERT_EQ(storage.append("a", {2, 3}), 102);
+        storage.patch("a", 0, {7});
+        ASSERT_THROW(storage.patch("a", 101, {1, 2}), std::logic_error);
+        ASSERT_EQ(std::filesystem::file_size(directory + "a.bin"), fileSize);
+        ASSERT_EQ(filesCount(directory + "deltas"), 1);
+
+        ASSERT_EQ(storage.loadSlice("a", 99, 200), (std::vector<int> {1, 2, 3}));
+        ASSERT_EQ(storage.load("a").front(), 7);
+        ASSERT_EQ(filesCount(directory + "deltas"), 0);
+        ASSERT_EQ(storage.append("a", {4}), 103);
+        ASSERT_EQ(storage.load("a").back(), 4);
+
+        storage.append("b", {4});
+        ASSERT_EQ(storage.compact(), 1);
+        ASSERT_EQ(filesCount(directory + "deltas"), 0);
+        ASSERT_EQ(storage.loadConst("b"), (std::vector<int> {1, 2, 3, 4}));
+
+        storage.fitSize();
+        storage.append("b", std::vector<int>(10, 5));
+        ASSERT_EQ(filesCount(directory + "deltas"), 0);
+        ASSERT_EQ(storage.loadConst("b").size(), 14);
+
+        storage.fitSize();
+        storage.append("b", {6});
+        {
+            auto const snapshot = storage.snapshot();
+            storage.patch("b", 0, {0});
+            ASSERT_EQ(snapshot.load("b").front(), 1);
+            ASSERT_EQ(snapshot.load("b").back(), 6);
+        }
+        storage.fitSize();
+        storage.append("b", {8});
+        ASSERT_THROW(storage.append("missing", {1}), std::logic_error);
+    }
+
+    params.loadAllOnCreate = true;
+    Storage<std::vector<int>> storage(params);
+    auto const& b = storage.loadConst("b");
+    ASSERT_EQ(b.size(), 16);
+    ASSERT_EQ(b.front(), 0);
+    ASSERT_EQ(b.back(), 8);
+    storage.erase("b");
+    ASSERT_EQ(filesCount(directory + "deltas"), 0);
+}
+
+TEST(Storage, appendAfterTornDelta) {
+    auto params = parameters("tornDelta");
+    params.cashSize = 0;
+    auto const log = params.path + "deltas/a.delta";
+    {
+        Storage<std::vector<int>> storage(params);
+        storage.store("a", {1, 2, 3});
+        storage.fitSize();
+        ASSERT_EQ(storage.append("a", {4}), 4);
+    }
+
+    auto const complete = std::filesystem::file_size(log);
+    {
+        std::ofstream stream(log, std::ios::binary | std::ios::app);
+        stream.put(1);
+        stream.put(7);
+    }
+
+    params.loadAllOnCreate = true;
+    {
+        Storage<std::vector<int>> storage(params);
+        ASSERT_EQ(std::filesystem::file_size(log), complete);
+        ASSERT_EQ(storage.append("a", {5}), 5);
+    }
+
+    Storage<std::vector<int>> storage(params);
+    ASSERT_EQ(storage.loadConst("a"), (std::vector<int> {1, 2, 3, 4, 5}));
+}
+
+TEST(Storage, nonContiguousValues) {
+    auto params = parameters("nonContiguousValues");
+    params.cashSize = 0;
+    params.chunkElements = 2;
+    params.serdeThreads = 2;
+    {
+        Storage<std::list<int>> storage(params);
+        storage.store("a", {1, 2, 3});
+        storage.fitSize();
+        ASSERT_EQ(storage.load("a"), (std::list<int> {1, 2, 3}));
+    }
+
+    std::filesystem::remove_all(params.path);
+    Storage<std::deque<int>> storage(params);
+    storage.store("a", {1, 2, 3});
+    storage.fitSize();
+    ASSERT_EQ(storage.loadConst("a"), (std::deque<int> {1, 2, 3}));
+    ASSERT_EQ(storage.residentBytes(), binary_storage::serde::memoryFootprint(std::deque<int> {1, 2, 3}));
+}
+
+TEST(Storage, residentBytes) {
+    using binary_storage::serde::memoryFootprint;
+
+    auto params = parameters("residentBytes");
+    params.cashSize = 0;
+    Storage<StorageValue> storage(params);
+    size_t expected = 0;
+    for (uint32_t i = 0; i < 10; ++i) {
+        auto value = makeValue(i * 100);
+        expected += memoryFootprint(value);
+        storage.store(std::to_string(i), std::move(value));
+    }
+    ASSERT_EQ(storage.residentBytes(), expected);
+
+    storage.store("0", makeValue(5000));
+    expected += memoryFootprint(makeValue(5000)) - memoryFootprint(makeValue(0));
+    ASSERT_EQ(storage.residentBytes(), expected);
+
+    storage.fitSize();
+    ASSERT_EQ(storage.residentBytes(), 0);
+
+    auto const& loaded = storage.loadConst("3");
+    ASSERT_EQ(storage.residentBytes(), memoryFootprint(loaded));
+
+    storage.erase("3");
+    ASSERT_EQ(storage.residentBytes(), 0);
+
+    storage.store("a", makeValue(1));
+    storage.clear();
+    ASSERT_EQ(storage.residentBytes(), 0);
+}
@@ -0,0 +1,155 @@
+#include <gtest/gtest.h>
+
+#include <storage/AutoStorage.hpp>
+#include <filesystem>
+#include <random>
+#include <thread>
+
+#include "Test.Parameters.hpp"
+
+using namespace binary_storage::storage;
+
+static std::vector<std::string> keys(std::vector<TimingWheel::Timer> const& timers) {
+    std::vector<std::string> result;
+    for (auto const& timer: timers) {
+        result.push_back(timer.key);
+    }
+    std::sort(result.begin(), result.end());
+    return result;
+}
+
+TEST(TimingWheel, firesOnDeadline) {
+    TimingWheel wheel;
+    wheel.schedule("now", 0);
+    wheel.schedule("soon", 5);
+    wheel.schedule("later", 100);
+    wheel.schedule("much later", 300000);
+    ASSERT_EQ(wheel.size(), 4);
+
+    ASSERT_EQ(keys(wheel.advance(4)), std::vector<std::string> {"now"});
+    ASSERT_EQ(keys(wheel.advance(5)), std::vector<std::string> {"soon"});
+    ASSERT_TRUE(wheel.advance(99).empty());
+    ASSERT_EQ(keys(wheel.advance(100)), std::vector<std::string> {"later"});
+    ASSERT_TRUE(wheel.advance(299999).empty());
+    ASSERT_EQ(keys(wheel.advance(300001)), std::vector<std::string> {"much later"});
+    ASSERT_EQ(wheel.size(), 0);
+}
+
+TEST(TimingWheel, randomDeadlines) {
+    TimingWheel wheel;
+    std::mt19937_64 random {7};
+    std::uniform_int_distribution<uint64_t> delay(0, 20000000);
+    std::vector<uint64_t> deadlines;
+    for (size_t i = 0; i < 2000; ++i) {
+        deadlines.push_back(delay(random));
+        wheel.schedule(std::to_string(i), deadlines.back());
+    }
+
+    size_t fired = 0;
+    for (uint64_t tick = 0; fired < deadlines.size(); tick += 997) {
+        for (auto const& timer: wheel.advance(tick)) {
+            ASSERT_EQ(timer.deadline, deadlines[std::stoul(timer.key)]);
+            ASSERT_LE(timer.deadline, tick);
+            ASSERT_GT(timer.deadline + 997, tick);
+            ++fired;
+        }
+    }
+    ASSERT_EQ(wheel.size(), 0);
+}
+
+TEST(TimingWheel, skipsIdleTicks) {
+    // Stepping through every tick would not finish.
+    TimingWheel wheel;
+    uint64_t const far = uint64_t {1} << 40;
+    wheel.schedule("far", far);
+    wheel.schedule("farther", far + 4096 + 3);
+    ASSERT_TRUE(wheel.advance(far - 1).empty());
+    ASSERT_EQ(keys(wheel.advance(far)), std::vector<std::string> {"far"});
+    ASSERT_EQ(wheel.size(), 1);
+
+    wheel.schedule("near", far + 70);
+    ASSERT_EQ(keys(wheel.advance(far + 4096 + 2)), std::vector<std::string> {"near"});
+    ASSERT_EQ(keys(wheel.advance(far + 4096 + 3)), std::vector<std::string> {"farther"});
+    ASSERT_EQ(wheel.size(), 0);
+    ASSERT_TRUE(wheel.advance(far * 2).empty());
+    ASSERT_EQ(wheel.current(), far * 2);
+}
+
+TEST(TimingWheel, storageExpiry) {
+    auto params = parameters("ttl");
+    params.saveAllOnDestruct = true;
+    Storage<std::vector<int>> storage(params);
+    storage.store("short", {1}, std::chrono::milliseconds {20});
+    storage.store("renewed", {2}, std::chrono::milliseconds {20});
+    storage.store("kept", {3});
+    storage.flush().wait();
+    storage.store("renewed", {4});
+
+    ASSERT_EQ(storage.expire(), 0);
+    ASSERT_TRUE(storage.contains("short"));
+    std::this_thread::sleep_for(std::chrono::milliseconds {40});
+
+    ASSERT_FALSE(storage.contains("short"));
+    ASSERT_EQ(storage.tryLoad("short"), nullptr);
+    ASSERT_EQ(storage.expire(), 1);
+    ASSERT_EQ(storage.size(), 2);
+    ASSERT_FALSE(std::filesystem::exists(params.path + "short.bin"));
+    ASSERT_EQ(storage.load("renewed"), std::vector<int> {4});
+}
+
+TEST(TimingWheel, expiredWithDeltas) {
+    auto params = parameters("ttlDeltas");
+    params.cashSize = 0;
+    Storage<std::vector<int>> storage(params);
+    storage.store("a", {1, 2, 3}, std::chrono::milliseconds {20});
+    storage.fitSize();
+    ASSERT_EQ(storage.append("a", {4}), 4);
+    std::this_thread::sleep_for(std::chrono::milliseconds {40});
+
+    ASSERT_THROW(storage.loadSlice("a", 0, 4), std::logic_error);
+    ASSERT_EQ(storage.expire(), 1);
+    ASSERT_FALSE(std::filesystem::exists(params.path + "a.bin"));
+    ASSERT_FALSE(std::filesystem::exists(params.path + "deltas/a.delta"));
+}
+
+TEST(TimingWheel, expiredReads) {
+    for (bool const lockFree: {false, true}) {
+        auto params = parameters("ttlReads");
+        params.lockFreeReads = lockFree;
+        params.cashSize = 1;
+        Storage<std::vector<int>> storage(params);
+        storage.store("resident", {1}, std::chrono::milliseconds {20});
+        storage.store("evicted", {2}, std::chrono::milliseconds {20});
+        storage.store("kept", {3});
+        storage.fitSize();
+        storage.store("resident", {1}, std::chrono::milliseconds {20});
+
+        ASSERT_EQ(storage.read("resident"), std::vector<int> {1});
+        ASSERT_EQ(storage.loadSlice("evicted", 0, 1), std::vector<int> {2});
+        ASSERT_EQ(storage.read("kept"), std::vector<int> {3});
+        std::this_thread::sleep_for(std::chrono::milliseconds {40});
+
+        for (auto const key: {"resident", "evicted"}) {
+            ASSERT_THROW(storage.read(key), std::logic_error);
+            ASSERT_THROW(storage.loadSlice(key, 0, 1), std::logic_error);
+            ASSERT_THROW(storage.loadConst(key), std::logic_error);
+            ASSERT_EQ(storage.tryLoadConst(key), nullptr);
+            ASSERT_FALSE(storage.contains(key));
+        }
+        ASSERT_EQ(storage.read("kept"), std::vector<int> {3});
+    }
+}
+
+TEST(TimingWheel, autoStorageExpiry) {
+    auto params = parameters("autoTtl");
+    params.backgroundInterval = std::chrono::milliseconds {5};
+    AutoStorage<std::vector<int>> storage(params);
+    storage.store("short", {1}, std::chrono::milliseconds {10});
+    storage.store("kept", {2});
+
+    for (int i = 0; i < 200 and storage.size() != 1; ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds {5});
+    }
+    ASSERT_EQ(storage.size(), 1);
+    ASSERT_EQ(storage.load("kept"), std::vector<int> {2});
+}
@@ -90,3 +90,34 @@ TEST(Value, store) {
     ASSERT_EQ(getData(value).b, data.b);
     ASSERT_DOUBLE_EQ(getData(value).c, data.c);
 }
+
+TEST(Value, demote) {
+    TestValue data;
+    data.b = std::string(1000, 'x');
+
+    auto value = createFromData(data);
+    ASSERT_GT(demoteValue(value, true), 0);
+    ASSERT_TRUE(isSerialized(value));
+    ASSERT_EQ(getData(value).b, data.b);
+    ASSERT_TRUE(isCashed(value));
+
+    demoteValue(value, false);
+    storeValue(value, std::string(path));
+    ASSERT_EQ(getData(value).b, data.b);
+}
+
+TEST(Value, cleanStore) {
+    TestValue data;
+
+    auto value = createFromData(data);
+    ASSERT_TRUE(storeValue(value, std::string(path)));
+
+    getData(value);
+    ASSERT_FALSE(value.revision.dirty());
+    ASSERT_FALSE(storeValue(value, std::string(path)));
+
+    getData(value).a = 42;
+    value.revision.touch();
+    ASSERT_TRUE(storeValue(value, std::string(path)));
+    ASSERT_EQ(getData(value).a, 42);
+}
@@ -1,6 +1,11 @@
 #include <gtest/gtest.h>
 
 #include <serde/serde.hpp>
+#include <serde/chunked.hpp>
+#include <serde/columnar.hpp>
+#include <serde/parallel.hpp>
+#include <storage/ThreadPool.hpp>
+#include <filesystem>
 #include <fstream>
 
 TEST(Deserialize, charTypes) {
@@ -274,3 +279,186 @@ TEST(Deserialize, customType) {
         ASSERT_DOUBLE_EQ(result.value().point.y, value.point.y);
     }
 }
+
+TEST(Deserialize, fields) {
+    using namespace binary_storage::serde;
+
+    TestDeserialization value {10, 113, "hello world", 0.3124, 22.315f, {1, 2, 3, 4, 5, 100, 2319}, {14.0123, -22.4159}};
+    std::stringstream stream;
+    serialize(stream, value);
+    serialize(stream, uint32_t {77});
+
+    auto const result = deserializeFields<&TestDeserialization::point, &TestDeserialization::c, &TestDeserialization::a>(stream);
+    ASSERT_EQ(result.has_value(), true);
+    ASSERT_DOUBLE_EQ(std::get<0>(*result).y, value.point.y);
+    ASSERT_EQ(std::get<1>(*result), value.c);
+    ASSERT_EQ(std::get<2>(*result), value.a);
+    ASSERT_EQ(deserialize<uint32_t>(stream), 77u);
+
+    std::stringstream partial;
+    serialize(partial, value);
+    auto const first = deserializeFields<&TestDeserialization::e>(partial);
+    ASSERT_EQ(first.has_value(), true);
+    ASSERT_FLOAT_EQ(std::get<0>(*first), value.e);
+    ASSERT_EQ(skip<std::vector<uint16_t>>(partial), true);
+    ASSERT_EQ(deserialize<Point>(partial)->x, value.point.x);
+
+    std::stringstream truncated(stream.str().substr(0, 8));
+    ASSERT_EQ((deserializeFields<&TestDeserialization::d>(truncated).has_value()), false);
+
+    // File streams seek past the end without failing.
+    std::stringstream whole;
+    serialize(whole, value);
+    auto const path = "/tmp/binary_storage_test/truncatedFields.bin";
+    std::filesystem::create_directories("/tmp/binary_storage_test");
+    for (size_t const size: {whole.str().size(), whole.str().size() - 1, whole.str().size() - 20}) {
+        {
+            std::ofstream file(path, std::ios::binary | std::ios::trunc);
+            file << whole.str().substr(0, size);
+        }
+
+        std::ifstream file(path, std::ios::binary);
+        ASSERT_EQ(skip<TestDeserialization>(file), size == whole.str().size()) << size;
+    }
+
+    std::ifstream file(path, std::ios::binary);
+    ASSERT_EQ(deserializeFields<&TestDeserialization::e>(file).has_value(), true);
+    ASSERT_EQ(skip<std::vector<uint16_t>>(file), false);
+}
+
+TEST(Deserialize, chunkedVector) {
+    using namespace binary_storage::serde;
+
+    std::vector<uint32_t> numbers(1000);
+    for (uint32_t i = 0; i < numbers.size(); ++i) {
+        numbers[i] = i * 3;
+    }
+
+    {
+        std::stringstream stream;
+        serializeChunked(stream, numbers, 64);
+        ASSERT_EQ(stream.str().size(), serializedChunkedSize(numbers, 64));
+        ASSERT_EQ(deserializeChunked<std::vector<uint32_t>>(stream), numbers);
+    }
+
+    {
+        std::stringstream stream;
+        serializeChunked(stream, numbers, 64);
+        auto const range = deserializeChunkedRange<std::vector<uint32_t>>(stream, 130, 260);
+        ASSERT_EQ(range, std::vector<uint32_t>(numbers.begin() + 130, numbers.begin() + 260));
+    }
+
+    {
+        std::stringstream stream;
+        serialize(stream, numbers);
+        auto const range = deserializeRange<std::vector<uint32_t>>(stream, 990, 2000);
+        ASSERT_EQ(range, std::vector<uint32_t>(numbers.begin() + 990, numbers.end()));
+    }
+
+    std::vector<std::string> words;
+    for (int i = 0; i < 100; ++i) {
+        words.push_back(std::string(i % 7, 'a' + i % 26));
+    }
+
+    {
+        std::stringstream stream;
+        serializeChunked(stream, words, 10);
+        auto const range = deserializeChunkedRange<std::vector<std::string>>(stream, 37, 55);
+        ASSERT_EQ(range, std::vector<std::string>(words.begin() + 37, words.begin() + 55));
+    }
+
+    {
+        std::stringstream stream;
+        serializeChunked(stream, words, 10);
+        ASSERT_EQ(deserializeChunkedRange<std::vector<std::string>>(stream, 120, 130)->size(), 0);
+    }
+}
+
+TEST(Deserialize, parallelChunked) {
+    using namespace binary_storage::serde;
+
+    binary_storage::storage::ThreadPool pool(3);
+    ParallelFor const parallelFor = [&] (size_t count, std::function<void(size_t)> const& task) {
+        pool.parallelFor(count, task);
+    };
+
+    std::vector<double> numbers(10007);
+    for (size_t i = 0; i < numbers.size(); ++i) {
+        numbers[i] = i * 0.5;
+    }
+
+    {
+        std::stringstream expected;
+        serializeChunked(expected, numbers, 256);
+        std::stringstream stream;
+        serializeChunkedParallel(stream, numbers, 256, parallelFor);
+        ASSERT_EQ(stream.str(), expected.str());
+        ASSERT_EQ(deserializeChunkedParallel<std::vector<double>>(stream.str(), parallelFor), numbers);
+        ASSERT_EQ(deserializeChunkedParallel<std::vector<double>>(stream.str().substr(0, 1000), parallelFor).has_value(), false);
+    }
+
+    std::vector<std::string> words;
+    for (int i = 0; i < 1000; ++i) {
+        words.push_back(std::string(i % 13, 'a' + i % 26));
+    }
+
+    {
+        std::stringstream expected;
+        serializeChunked(expected, words, 64);
+        std::stringstream stream;
+        serializeChunkedParallel(stream, words, 64, parallelFor);
+        ASSERT_EQ(stream.str(), expected.str());
+        ASSERT_EQ(deserializeChunkedParallel<std::vector<std::string>>(stream.str(), parallelFor), words);
+    }
+
+    {
+        std::stringstream stream;
+        serializeChunkedParallel(stream, std::vector<std::string> {}, 64, parallelFor);
+        ASSERT_EQ(deserializeChunkedParallel<std::vector<std::string>>(stream.str(), parallelFor)->size(), 0);
+    }
+}
+
+TEST(Deserialize, columnar) {
+    using namespace binary_storage::serde;
+
+    std::vector<TestDeserialization> records;
+    for (int i = 0; i < 50; ++i) {
+        records.push_back({i, static_cast<uint8_t>(i * 2), std::to_string(i), i * 0.5, i * 0.25f,
+                           std::vector<uint16_t>(i % 5, static_cast<uint16_t>(i)), {i * 1.0, -i * 1.0}});
+    }
+
+    {
+        std::stringstream stream;
+        serializeColumnar(stream, records);
+        ASSERT_EQ(stream.str().size(), serializedSize(records));
+
+        auto const result = deserializeColumnar<std::vector<TestDeserialization>>(stream);
+        ASSERT_EQ(result.has_value(), true);
+        ASSERT_EQ(result->size(), records.size());
+        for (size_t i = 0; i < records.size(); ++i) {
+            ASSERT_EQ((*result)[i].a, records[i].a);
+            ASSERT_EQ((*result)[i].c, records[i].c);
+            ASSERT_EQ((*result)[i].f, records[i].f);
+            ASSERT_DOUBLE_EQ((*result)[i].point.y, records[i].point.y);
+        }
+    }
+
+    {
+        std::stringstream stream;
+        serializeColumnar(stream, records);
+        auto const columns = deserializeColumns<&TestDeserialization::d, &TestDeserialization::b>(stream);
+        ASSERT_EQ(columns.has_value(), true);
+        ASSERT_EQ(std::get<0>(*columns).size(), records.size());
+        ASSERT_DOUBLE_EQ(std::get<0>(*columns)[7], 3.5);
+        ASSERT_EQ(std::get<1>(*columns)[7], 14);
+    }
+
+    {
+        std::stringstream stream;
+        serialize(stream, records);
+        auto const columns = deserializeColumnsFromRows<&TestDeserialization::c, &TestDeserialization::point>(stream);
+        ASSERT_EQ(columns.has_value(), true);
+        ASSERT_EQ(std::get<0>(*columns)[42], "42");
+        ASSERT_DOUBLE_EQ(std::get<1>(*columns)[42].x, 42.0);
+    }
+}
@@ -1,9 +1,12 @@
 #include <gtest/gtest.h>
 #include <refl.hpp>
 
+#include <deque>
+#include <list>
 #include <sstream>
 
 #include <serde/serde.hpp>
+#include <serde/footprint.hpp>
 
 
 TEST(Serialize, IntTypesSizes) {
@@ -150,3 +153,77 @@ TEST(Serialize, stringTypeSize) {
         ASSERT_EQ(stream.str().size(), size);
     }
 }
+
+TEST(Serialize, serializedSize) {
+    using namespace binary_storage::serde;
+    {
+        std::stringstream stream;
+        TestStruct custom;
+        serialize(stream, custom);
+        ASSERT_EQ(serializedSize(custom), stream.str().size());
+    }
+
+    {
+        std::stringstream stream;
+        std::vector<std::string> value {"hello", "", "world!"};
+        serialize(stream, value);
+        ASSERT_EQ(serializedSize(value), stream.str().size());
+    }
+
+    {
+        std::stringstream stream;
+        std::vector<TestStruct> value(7);
+        serialize(stream, value);
+        ASSERT_EQ(serializedSize(value), stream.str().size());
+    }
+}
+
+struct FootprintStruct {
+    int id {0};
+    std::string name;
+    std::vector<std::string> tags;
+};
+
+REFL_AUTO(
+    type(FootprintStruct),
+    field(id),
+    field(name),
+    field(tags)
+)
+
+TEST(Serialize, memoryFootprint) {
+    using namespace binary_storage::serde;
+
+    ASSERT_EQ(memoryFootprint(int64_t {1}), sizeof(int64_t));
+    ASSERT_EQ(memoryFootprint(TestStruct {}), sizeof(TestStruct));
+
+    std::vector<double> numbers;
+    numbers.reserve(100);
+    numbers.resize(10);
+    ASSERT_EQ(memoryFootprint(numbers), sizeof(numbers) + 100 * sizeof(double));
+
+    std::string const small {"a"};
+    std::string const large(1000, 'x');
+    ASSERT_EQ(memoryFootprint(small), sizeof(std::string));
+    ASSERT_EQ(memoryFootprint(large), sizeof(std::string) + large.capacity() + 1);
+
+    FootprintStruct value {7, large, {small, large}};
+    value.tags.shrink_to_fit();
+    ASSERT_EQ(memoryFootprint(value), sizeof(FootprintStruct) + 2 * (large.capacity() + 1) + 2 * sizeof(std::string));
+}
+
+TEST(Serialize, nonContiguousContainers) {
+    using namespace binary_storage::serde;
+    static_assert(isContiguous<std::vector<int>> and isContiguous<std::vector<bool>>);
+    static_assert(not isContiguous<std::deque<int>> and not isContiguous<std::list<int>> and not isContiguous<std::string>);
+
+    std::deque<int> const numbers {1, 2, 3};
+    ASSERT_EQ(memoryFootprint(numbers), sizeof(numbers) + 3 * sizeof(int));
+
+    std::list<std::string> const strings {"a", std::string(1000, 'x')};
+    ASSERT_GE(memoryFootprint(strings), sizeof(strings) + 2 * sizeof(std::string) + 1000);
+
+    std::stringstream stream;
+    serialize(stream, strings);
+    ASSERT_EQ(deserialize<std::list<std::string>>(stream), strings);
+}